@@ -1,5 +1,11 @@
 #include <benchmark/benchmark.h>
 #include <cstdlib>
+#include <thread>
+#include "reduction.h"
+#include "vectorize_guard.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
 
 const unsigned long fromRange = 8;
 const unsigned long toRange = 1 << 20;
@@ -27,16 +33,19 @@ struct AdderNoAlias
 void AdderNoAlias::add(const int* values, const size_t count)
 {
 	int total = 0;
+	VECTORIZE_GUARD_BEGIN("AdderNoAlias::add", "avx");
 	for (size_t i = 0; i < count; i++)
 	{
 		total += values[i];
 	}
+	VECTORIZE_GUARD_END("AdderNoAlias::add");
 	mTotal = total;
 }
 
 
 static void BM_AdderAlias(benchmark::State& state)
 {
+	AllocationCounters allocations(state);
 	const auto length = state.range(0);
 	AdderAlias adder;
 	std::vector<int> values;
@@ -45,17 +54,18 @@ static void BM_AdderAlias(benchmark::State& state)
 	{
 		v = rand() % 32768;
 	}
-	for (auto _ : state)
+	for (auto _ : allocations.Loop())
 	{
 		adder.mTotal = 0;
 		adder.add(&values[0], values.size());
 		benchmark::DoNotOptimize(adder);
 	}
 }
-BENCHMARK(BM_AdderAlias)->Range(fromRange, toRange);
+BENCH_SWEEP(BM_AdderAlias)->Range(fromRange, toRange);
 
 static void BM_AdderNoAlias(benchmark::State& state)
 {
+	AllocationCounters allocations(state);
 	const auto length = state.range(0);
 	AdderNoAlias adder;
 	std::vector<int> values;
@@ -64,12 +74,141 @@ static void BM_AdderNoAlias(benchmark::State& state)
 	{
 		v = rand() % 32768;
 	}
-	for (auto _ : state)
+	for (auto _ : allocations.Loop())
 	{
 		adder.mTotal = 0;
 		adder.add(&values[0], values.size());
 		benchmark::DoNotOptimize(adder);
 	}
 }
-BENCHMARK(BM_AdderNoAlias)->Range(fromRange, toRange);
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCH_SWEEP(BM_AdderNoAlias)->Range(fromRange, toRange);
+static std::vector<int> RandomValues(const std::size_t length)
+{
+	std::vector<int> values(length);
+	for (auto& v : values)
+	{
+		v = rand() % 32768;
+	}
+	return values;
+}
+
+static std::vector<float> RandomFloats(const std::size_t length)
+{
+	std::vector<float> values(length);
+	for (auto& v : values)
+	{
+		v = static_cast<float>(rand()) / RAND_MAX;
+	}
+	return values;
+}
+
+static void BM_AdderRestrict(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomValues(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		int total = 0;
+		AddRestrict(&total, values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_AdderRestrict)->Range(fromRange, toRange);
+
+static void BM_SumAvx2(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomValues(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		int total = SumAvx2(values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_SumAvx2)->Range(fromRange, toRange);
+
+static void BM_SumWiden(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomValues(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		std::int64_t total = SumWiden(values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_SumWiden)->Range(fromRange, toRange);
+
+static void BM_SumFloatNaive(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomFloats(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		float total = 0.0f;
+		for (const float v : values)
+		{
+			total += v;
+		}
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_SumFloatNaive)->Range(fromRange, toRange);
+
+static void BM_SumKahan(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomFloats(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		float total = SumKahan(values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_SumKahan)->Range(fromRange, toRange);
+
+static void BM_SumPairwise(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomFloats(state.range(0));
+	for (auto _ : allocations.Loop())
+	{
+		float total = SumPairwise(values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCH_SWEEP(BM_SumPairwise)->Range(fromRange, toRange);
+
+static void BM_ParallelTreeSum(benchmark::State& state)
+{
+	AllocationCounters allocations(state);
+	const auto values = RandomValues(state.range(0));
+	TreeSumWorkers workers(static_cast<int>(state.range(1)));
+	for (auto _ : allocations.Loop())
+	{
+		std::int64_t total = ParallelTreeSum(workers, values.data(), values.size());
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void ParallelTreeArguments(benchmark::internal::Benchmark* b)
+{
+	const long hardwareThreads = std::max(1l, static_cast<long>(std::thread::hardware_concurrency()));
+	for (const auto length : benchmark::CreateRange(fromRange, toRange, 8))
+	{
+		for (long threads = 1; threads < hardwareThreads; threads *= 2)
+		{
+			b->Args({length, threads});
+		}
+		b->Args({length, hardwareThreads});
+	}
+}
+BENCH_SWEEP(BM_ParallelTreeSum)->Apply(ParallelTreeArguments)->UseRealTime();
+BENCH_HARNESS_MAIN();
\ No newline at end of file
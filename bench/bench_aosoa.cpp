@@ -22,138 +22,107 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 #include <vector>
+#include <algorithm>
 #include <list>
 #include <array>
 #include <iostream>
 #include <benchmark/benchmark.h>
 #include <memory>
 #include <cmath>
+#include <thread>
 #include "intrinsics.h"
-
-
-#define ENTITY_NUMBERS (1'024*1'024)
-
-namespace sfge
-{
-struct Vec2f
+#include "vec2.h"
+#include "aosoa.h"
+#include "vectorize_guard.h"
+#include "latency_histogram.h"
+#include "linked_lists.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "task_graph.h"
+#include "harness.h"
+#include "sweep.h"
+
+struct TransformSample
 {
-    float x = 0.0f;
-    float y = 0.0f;
-    Vec2f(float x, float y)
-        : x(x), y(y)
-    {
-
-    }
-    Vec2f()
-    {
-
-    }
-
-    float GetMagnitude()
-    {
-        return sqrtf(x * x + y * y);
-    }
-
-    Vec2f Normalized()
-    {
-        return (*this) / (*this).GetMagnitude();
-    }
-
-    bool operator==(const Vec2f& rhs) const
-    {
-        return x == rhs.x && y == rhs.y;
-    }
-
-    bool operator!=(const Vec2f& rhs) const
-    {
-        return !(rhs == *this);
-    }
-
-    Vec2f operator+(const Vec2f& rhs) const
-    {
-        return Vec2f(x + rhs.x, y + rhs.y);
-    }
-
-    Vec2f operator-(const Vec2f& rhs) const
-    {
-        return Vec2f(x - rhs.x, y - rhs.y);
-    }
+    float positionX;
+    float positionY;
+    float scaleX;
+    float scaleY;
+    float eulerAngle;
+};
 
-    Vec2f operator*(float rhs) const
-    {
-        return Vec2f(x * rhs, y * rhs);
-    }
+//Initial transforms shared by every layout, generated once instead of per system construction. Bigger systems
+//reuse them cyclically.
+constexpr std::size_t transformSamples = 1'024 * 1'024;
 
-    Vec2f operator/(float rhs) const
+static std::span<const TransformSample> TransformDataset()
+{
+    return CachedDataset<TransformSample>("aosoa_transforms", transformSamples, 1,
+                                          [](std::span<TransformSample> samples, std::mt19937_64& gen)
     {
-        return (*this) * (1.0f / rhs);
-    }
+        std::uniform_int_distribution<int> dis(0, RAND_MAX);
+        for (auto& sample : samples)
+        {
+            sample.positionX = dis(gen);
+            sample.positionY = dis(gen);
+            sample.scaleX = dis(gen);
+            sample.scaleY = dis(gen);
+            sample.eulerAngle = dis(gen);
+        }
+    });
+}
 
-    Vec2f& operator+=(const Vec2f& rhs)
-    {
-        this->x += rhs.x;
-        this->y += rhs.y;
-        return *this;
-    }
-    Vec2f& operator*=(const float& rhs)
-    {
-        this->x *= rhs;
-        this->y *= rhs;
-        return *this;
-    }
+//Transforms of a number of entities chosen at runtime, stored the way LayoutPolicy lays them out. The policy is
+//built from the entity count, implements the Translate, Scale and Rotate passes and declares in
+//updateBytesPerEntity the transform bytes the three passes read and write per entity.
+template<typename LayoutPolicy>
+class TransformSystem : public LayoutPolicy
+{
+public:
+    explicit TransformSystem(std::size_t entityCount) : LayoutPolicy(entityCount), m_EntityCount(entityCount) {}
 
-    Vec2f Lerp(const Vec2f& v1, const Vec2f& v2, float t)
-    {
-        return v1 + (v2 - v1) * t;
-    }
-    float Dot(const Vec2f& v1, const Vec2f& v2)
-    {
-        return v1.x * v2.x + v1.y * v2.y;
-    }
-    Vec2f& operator-=(const Vec2f& rhs)
-    {
-        this->x -= rhs.x;
-        this->y -= rhs.y;
-        return *this;
-    }
+    [[nodiscard]] std::size_t Size() const { return m_EntityCount; }
+    [[nodiscard]] std::size_t UpdateBytes() const { return m_EntityCount * LayoutPolicy::updateBytesPerEntity; }
+private:
+    std::size_t m_EntityCount;
 };
-}
 
-#define SOA_VECTOR2
 namespace SOA
 {
-#ifndef SOA_VECTOR2
-class TransformSystem
+//One float array per component
+class SplitLayout
 {
 public:
-    TransformSystem()
-    {
-        m_PositionsX.resize(ENTITY_NUMBERS);
-        m_PositionsY.resize(ENTITY_NUMBERS);
-        m_ScalesX.resize(ENTITY_NUMBERS);
-        m_ScalesY.resize(ENTITY_NUMBERS);
-        m_EulerAngles.resize(ENTITY_NUMBERS);
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+    //Each pass reads and writes only its own components
+    static constexpr std::size_t updateBytesPerEntity = 2 * 5 * sizeof(float);
+
+    explicit SplitLayout(std::size_t entityCount)
+        : m_PositionsX(entityCount), m_PositionsY(entityCount), m_ScalesX(entityCount), m_ScalesY(entityCount),
+          m_EulerAngles(entityCount)
+    {
+        const auto samples = TransformDataset();
+        for (std::size_t i = 0; i < entityCount; i++)
         {
-            m_PositionsX[i] = rand();
-            m_PositionsY[i] = rand();
-            m_ScalesX[i] = rand();
-            m_ScalesY[i] = rand();
-            m_EulerAngles[i] = rand();
+            const auto& sample = samples[i % samples.size()];
+            m_PositionsX[i] = sample.positionX;
+            m_PositionsY[i] = sample.positionY;
+            m_ScalesX[i] = sample.scaleX;
+            m_ScalesY[i] = sample.scaleY;
+            m_EulerAngles[i] = sample.eulerAngle;
         }
     }
     void Translate(sfge::Vec2f moveValue)
     {
-
+        VECTORIZE_GUARD_BEGIN("SOA::SplitLayout::Translate", "avx");
         for (float& i : m_PositionsX)
         {
             i += moveValue.x;
         }
-
         for (float& i : m_PositionsY)
         {
             i += moveValue.y;
         }
+        VECTORIZE_GUARD_END("SOA::SplitLayout::Translate");
     }
     void Scale(float scaleValue)
     {
@@ -168,9 +137,9 @@ public:
     }
     void Rotate(float rotateValue)
     {
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+        for (auto& eulerAngle : m_EulerAngles)
         {
-            m_EulerAngles[i] += rotateValue;
+            eulerAngle += rotateValue;
         }
     }
 private:
@@ -180,51 +149,63 @@ private:
     std::vector<float> m_ScalesY;
     std::vector<float> m_EulerAngles;
 };
-#else
-class TransformSystem
+
+//Positions and scales as Vec2 arrays
+class Vec2Layout
 {
 public:
-    TransformSystem()
+    static constexpr std::size_t updateBytesPerEntity = 2 * 5 * sizeof(float);
+
+    explicit Vec2Layout(std::size_t entityCount)
+        : m_Positions(entityCount), m_Scales(entityCount), m_EulerAngles(entityCount)
     {
-        m_Positions.resize(ENTITY_NUMBERS);
-        m_Scales.resize(ENTITY_NUMBERS);
-        m_EulerAngles.resize(ENTITY_NUMBERS);
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+        const auto samples = TransformDataset();
+        for (std::size_t i = 0; i < entityCount; i++)
         {
-            m_Positions[i] = sfge::Vec2f(rand(), rand());
-            m_Scales[i] = sfge::Vec2f(rand(), rand());
-            m_EulerAngles[i] = rand();
+            const auto& sample = samples[i % samples.size()];
+            m_Positions[i] = sfge::Vec2f(sample.positionX, sample.positionY);
+            m_Scales[i] = sfge::Vec2f(sample.scaleX, sample.scaleY);
+            m_EulerAngles[i] = sample.eulerAngle;
         }
     }
-    void Translate(sfge::Vec2f moveValue)
+    void Translate(sfge::Vec2f moveValue) { Translate(moveValue, 0, m_Positions.size()); }
+    void Scale(float scaleValue) { Scale(scaleValue, 0, m_Scales.size()); }
+    void Rotate(float rotateValue) { Rotate(rotateValue, 0, m_EulerAngles.size()); }
+
+    //The range overloads let the task graph split each update over workers
+    void Translate(sfge::Vec2f moveValue, std::size_t begin, std::size_t end)
     {
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+        VECTORIZE_GUARD_BEGIN("SOA::Vec2Layout::Translate", "avx");
+        for (std::size_t i = begin; i < end; i++)
         {
             m_Positions[i] += moveValue;
         }
+        VECTORIZE_GUARD_END("SOA::Vec2Layout::Translate");
     }
-    void Scale(float scaleValue)
+    void Scale(float scaleValue, std::size_t begin, std::size_t end)
     {
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+        VECTORIZE_GUARD_BEGIN("SOA::Vec2Layout::Scale", "avx");
+        for (std::size_t i = begin; i < end; i++)
         {
             m_Scales[i] *= scaleValue;
         }
+        VECTORIZE_GUARD_END("SOA::Vec2Layout::Scale");
     }
-    void Rotate(float rotateValue)
+    void Rotate(float rotateValue, std::size_t begin, std::size_t end)
     {
-        for (int i = 0; i < ENTITY_NUMBERS; i++)
+        VECTORIZE_GUARD_BEGIN("SOA::Vec2Layout::Rotate", "avx");
+        for (std::size_t i = begin; i < end; i++)
         {
             m_EulerAngles[i] += rotateValue;
         }
+        VECTORIZE_GUARD_END("SOA::Vec2Layout::Rotate");
     }
 private:
     std::vector<sfge::Vec2f> m_Positions;
     std::vector<sfge::Vec2f> m_Scales;
     std::vector<float> m_EulerAngles;
 };
-#endif
 }
-//#define AOS_LIST
 namespace AOS
 {
 struct Transform
@@ -234,194 +215,129 @@ struct Transform
     float eulerAngle;
 };
 
-class TransformSystem
+//Containers of Layout, chosen per benchmark run
+enum TransformContainer : long
+{
+    VectorContainer = 0,
+    StdListContainer = 1,
+    //Intrusive links, nodes allocated from one contiguous pool
+    PoolListContainer = 2,
+    //One cache line (two transforms) per node
+    UnrolledListContainer = 3,
+    //Four cache lines (eleven transforms) per node
+    UnrolledList4Container = 4,
+};
+constexpr const char* containerNames[] = {"vector", "std_list", "pool_list", "unrolled_64B", "unrolled_256B"};
+
+//One Transform struct per entity. Container holds Transform and has the interface of linked_lists.h: begin,
+//end, size, insert and erase.
+template<typename Container>
+class Layout
 {
 public:
-    TransformSystem()
+    //Every pass streams the whole structs, node links not included
+    static constexpr std::size_t updateBytesPerEntity = 3 * 2 * sizeof(Transform);
+
+    explicit Layout(std::size_t entityCount)
     {
-        m_Transforms.resize(ENTITY_NUMBERS);
-        for (auto& transform : m_Transforms)
+        if constexpr (requires { m_Transforms.reserve(entityCount); })
+        {
+            m_Transforms.reserve(entityCount);
+        }
+        const auto samples = TransformDataset();
+        for (std::size_t i = 0; i < entityCount; i++)
         {
-            transform.position = sfge::Vec2f(rand(), rand());
-            transform.scale = sfge::Vec2f(rand(), rand());
-            transform.eulerAngle = rand();
+            const auto& sample = samples[i % samples.size()];
+            m_Transforms.insert(m_Transforms.end(), Transform{sfge::Vec2f(sample.positionX, sample.positionY),
+                                                              sfge::Vec2f(sample.scaleX, sample.scaleY),
+                                                              sample.eulerAngle});
         }
     }
 
     void Translate(sfge::Vec2f moveValue)
     {
-        for (auto& transform : m_Transforms)
-        {
-            transform.position += moveValue;
-        }
+        ForEachElement(m_Transforms, [moveValue](Transform& transform) { transform.position += moveValue; });
     }
     void Scale(float scaleValue)
     {
-        for (auto& transform : m_Transforms)
-        {
-            transform.scale *= scaleValue;
-        }
+        ForEachElement(m_Transforms, [scaleValue](Transform& transform) { transform.scale *= scaleValue; });
     }
     void Rotate(float rotateValue)
     {
-        for (auto& transform : m_Transforms)
-        {
-            transform.eulerAngle += rotateValue;
-        }
+        ForEachElement(m_Transforms, [rotateValue](Transform& transform) { transform.eulerAngle += rotateValue; });
     }
-private:
-#ifdef AOS_LIST
-    std::list <Transform> m_Transforms;
-#else
-    std::vector<Transform> m_Transforms;
-#endif
-};
-}
 
-namespace AOSOA
-{
-template<size_t N>
-struct  alignas(N * sizeof(float)) NPos
-{
-    std::array<float, N> posX;
-    std::array<float, N> posY;
-    void TranslateIntrinsics(sfge::Vec2f moveValue);
-};
-#ifdef __SSE__
-template<>
-inline void NPos<4>::TranslateIntrinsics(sfge::Vec2f moveValue)
-{
-    auto x = _mm_load1_ps(&moveValue.x);
-    auto y = _mm_load1_ps(&moveValue.y);
-
-    auto px = _mm_load_ps(posX.data());
-    auto py = _mm_load_ps(posY.data());
-
-    px = _mm_add_ps(px, x);
-    py = _mm_add_ps(py, y);
-
-    _mm_store_ps(posX.data(), px);
-    _mm_store_ps(posY.data(), py);
-}
-#endif
-#ifdef __AVX__
-template<>
-inline void NPos<8>::TranslateIntrinsics(sfge::Vec2f moveValue)
-{
-    auto x = _mm256_broadcast_ss(&moveValue.x);
-    auto y = _mm256_broadcast_ss(&moveValue.y);
-
-    auto px = _mm256_load_ps(posX.data());
-    auto py = _mm256_load_ps(posY.data());
-
-    px = _mm256_add_ps(px, x);
-    py = _mm256_add_ps(py, y);
-
-    _mm256_store_ps(posX.data(), px);
-    _mm256_store_ps(posY.data(), py);
-}
-#endif
-
-template<size_t N>
-struct  alignas(N * sizeof(float)) NScale
-{
-    std::array<float, N> scaleX;
-    std::array<float, N> scaleY;
-    void ScaleIntrinsics(float scaleValue);
+    //Erases the transform at index and returns it
+    Transform EraseAt(std::size_t index)
+    {
+        const auto position = IteratorAt(m_Transforms, index);
+        const Transform transform = *position;
+        m_Transforms.erase(position);
+        return transform;
+    }
+    void InsertAt(std::size_t index, const Transform& transform)
+    {
+        m_Transforms.insert(IteratorAt(m_Transforms, index), transform);
+    }
+private:
+    Container m_Transforms;
 };
 
-#ifdef __SSE__
-template <>
-inline void NScale<4>::ScaleIntrinsics(float scaleValue)
+//Builds the system of the given container and hands it to f
+template<typename F>
+void VisitTransformSystem(TransformContainer container, std::size_t entityCount, F&& f)
 {
-    auto x = _mm_load1_ps(&scaleValue);
-
-    auto px = _mm_load_ps(scaleX.data());
-    auto py = _mm_load_ps(scaleY.data());
-
-    px = _mm_mul_ps(px, x);
-    py = _mm_mul_ps(py, x);
-
-    _mm_store_ps(scaleX.data(), px);
-    _mm_store_ps(scaleY.data(), py);
+    switch (container)
+    {
+    case VectorContainer:
+        f(*std::make_unique<::TransformSystem<Layout<std::vector<Transform>>>>(entityCount));
+        break;
+    case StdListContainer:
+        f(*std::make_unique<::TransformSystem<Layout<std::list<Transform>>>>(entityCount));
+        break;
+    case PoolListContainer:
+        f(*std::make_unique<::TransformSystem<Layout<PoolList<Transform>>>>(entityCount));
+        break;
+    case UnrolledListContainer:
+        f(*std::make_unique<::TransformSystem<Layout<UnrolledList<Transform, 64>>>>(entityCount));
+        break;
+    case UnrolledList4Container:
+        f(*std::make_unique<::TransformSystem<Layout<UnrolledList<Transform, 256>>>>(entityCount));
+        break;
+    }
 }
-#endif
-#ifdef __AVX__
-template<>
-inline void NScale<8>::ScaleIntrinsics(float scaleValue)
-{
-    auto x = _mm256_broadcast_ss(&scaleValue);
-
-    auto px = _mm256_load_ps(scaleX.data());
-    auto py = _mm256_load_ps(scaleY.data());
-
-    px = _mm256_mul_ps(px, x);
-    py = _mm256_mul_ps(py, x);
-
-    _mm256_store_ps(scaleX.data(), px);
-    _mm256_store_ps(scaleY.data(), py);
 }
-#endif
 
-template <size_t N>
-struct  alignas(N * sizeof(float)) NAngle
-{
-    std::array<float, N> eulerAngles;
-
-    void RotateIntrinsics(float angle);
-
-};
-
-#ifdef __SSE__
-template<>
-inline void NAngle<4>::RotateIntrinsics(float angle)
-{
-    auto a = _mm_load1_ps(&angle);
-    auto as = _mm_load_ps(eulerAngles.data());
-
-    as = _mm_add_ps(a, as);
-
-    _mm_store_ps(eulerAngles.data(), as);
-}
-#endif
-#ifdef __AVX__
-template<>
-inline void NAngle<8>::RotateIntrinsics(float angle)
+namespace AOSOA
 {
-    auto a = _mm256_broadcast_ss(&angle);
-    auto as = _mm256_load_ps(eulerAngles.data());
-
-    as = _mm256_add_ps(a, as);
-
-    _mm256_store_ps(eulerAngles.data(), as);
-}
-#endif
-
+//Blocks of N entities, each component of the block in its own lane array
 template<size_t N>
-class TransformSystem
+class Layout
 {
 public:
-    TransformSystem()
+    static constexpr std::size_t updateBytesPerEntity = 2 * 5 * sizeof(float);
+
+    //The last block is filled up with samples
+    explicit Layout(std::size_t entityCount)
+        : m_Positions((entityCount + N - 1) / N), m_Scales(m_Positions.size()), m_EulerAngles(m_Positions.size())
     {
-        m_Positions.resize(ENTITY_NUMBERS / N);
-        m_Scales.resize(ENTITY_NUMBERS / N);
-        m_EulerAngles.resize(ENTITY_NUMBERS / N);
-        for (int i = 0; i < ENTITY_NUMBERS / N; i++)
+        const auto samples = TransformDataset();
+        for (std::size_t i = 0; i < m_Positions.size(); i++)
         {
-            for (int j = 0; j < N; j++)
+            for (std::size_t j = 0; j < N; j++)
             {
-
-                m_Positions[i].posX[j] = rand();
-                m_Positions[i].posY[j] = rand();
-                m_Scales[i].scaleX[j] = rand();
-                m_Scales[i].scaleY[j] = rand();
-                m_EulerAngles[i].eulerAngles[j] = rand();
+                const auto& sample = samples[(i * N + j) % samples.size()];
+                m_Positions[i].posX[j] = sample.positionX;
+                m_Positions[i].posY[j] = sample.positionY;
+                m_Scales[i].scaleX[j] = sample.scaleX;
+                m_Scales[i].scaleY[j] = sample.scaleY;
+                m_EulerAngles[i].eulerAngles[j] = sample.eulerAngle;
             }
         }
     }
     void Translate(sfge::Vec2f moveValue)
     {
-
+        VECTORIZE_GUARD_BEGIN("AOSOA::Layout::Translate", "sse");
         for (auto& pos : m_Positions)
         {
             for (int j = 0; j < N; j++)
@@ -430,6 +346,7 @@ public:
                 pos.posY[j] += moveValue.y;
             }
         }
+        VECTORIZE_GUARD_END("AOSOA::Layout::Translate");
     }
     void Scale(float scaleValue)
     {
@@ -481,87 +398,280 @@ private:
 };
 }
 
+//One update of every entity per iteration: entities per second and the transform bytes streamed per second
+template<typename LayoutPolicy>
+static void ReportTransformThroughput(benchmark::State& state, const TransformSystem<LayoutPolicy>& transformSystem)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(transformSystem.Size()) * state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(transformSystem.UpdateBytes()) * state.iterations());
+}
+
+constexpr int64_t minEntities = 1 << 10;
+constexpr int64_t maxEntities = 1 << 26;
+
+//Every container up to 16M entities and the vector up to 64M, the linked containers take more than twice the
+//memory of the vector
+static void AosArguments(benchmark::internal::Benchmark* b)
+{
+    for (long container = AOS::VectorContainer; container <= AOS::UnrolledList4Container; container++)
+    {
+        const int64_t maxCount = container == AOS::VectorContainer ? maxEntities : maxEntities / 4;
+        for (int64_t entities = minEntities; entities < maxCount; entities *= 8)
+        {
+            b->Args({container, entities});
+        }
+        b->Args({container, maxCount});
+    }
+}
+
 static void BM_AOS(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<AOS::TransformSystem>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    const auto container = static_cast<AOS::TransformContainer>(state.range(0));
+    AOS::VisitTransformSystem(container, state.range(1), [&](auto& transformSystem)
+    {
+        for (auto _ : allocations.Loop())
+        {
+            transformSystem.Translate(sfge::Vec2f(22.0f, -4.0f));
+            transformSystem.Scale(3.0f);
+            transformSystem.Rotate(45.0f);
+        }
+        ReportTransformThroughput(state, transformSystem);
+    });
+    state.SetLabel(AOS::containerNames[container]);
+}
+// Register the function as a benchmark
+BENCH_SWEEP(BM_AOS)->Apply(AosArguments)->ArgNames({"container", "entities"});
+
+constexpr std::size_t aosEdits = 64;
+
+static std::span<const std::uint32_t> AosEditPositions()
+{
+    return CachedDataset<std::uint32_t>("aos_edit_positions", 2 * aosEdits, 1,
+                                        [](std::span<std::uint32_t> positions, std::mt19937_64& gen)
+    {
+        for (auto& position : positions)
+        {
+            position = static_cast<std::uint32_t>(gen());
+        }
+    });
+}
+
+//Scene graph edits: each edit erases the transform at a random position and inserts it back at another one.
+//Reaching the position is part of the cost, an index for the vector and a walk for the lists, the vector then
+//moves the tail of its array while the lists relink.
+static void BM_AOSInsertErase(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const auto container = static_cast<AOS::TransformContainer>(state.range(0));
+    const auto entities = static_cast<std::size_t>(state.range(1));
+    const auto positions = AosEditPositions();
+    AOS::VisitTransformSystem(container, entities, [&](auto& transformSystem)
+    {
+        for (auto _ : allocations.Loop())
+        {
+            for (std::size_t i = 0; i < aosEdits; i++)
+            {
+                const auto transform = transformSystem.EraseAt(positions[2 * i] % entities);
+                transformSystem.InsertAt(positions[2 * i + 1] % entities, transform);
+            }
+        }
+    });
+    state.SetItemsProcessed(static_cast<int64_t>(aosEdits) * state.iterations());
+    state.SetLabel(AOS::containerNames[container]);
+}
+
+BENCH_SWEEP(BM_AOSInsertErase)
+    ->ArgsProduct({benchmark::CreateDenseRange(AOS::VectorContainer, AOS::UnrolledList4Container, 1),
+                   {1 << 10, 1 << 13, 1 << 16}})
+    ->ArgNames({"container", "entities"});
+
+static void BM_SOASplit(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<SOA::SplitLayout>>(state.range(0));
+    for (auto _ : allocations.Loop())
     {
         transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->Scale(3.0f);
         transformSystem->Rotate(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
 }
-// Register the function as a benchmark
-BENCHMARK(BM_AOS);
+
+BENCH_SWEEP(BM_SOASplit)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
 
 static void BM_SOA(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<SOA::TransformSystem>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<SOA::Vec2Layout>>(state.range(0));
+    for (auto _ : allocations.Loop())
     {
         transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->Scale(3.0f);
         transformSystem->Rotate(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
+}
+
+BENCH_SWEEP(BM_SOA)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
+
+//Entity counts from 64k, below one grain per system the graph has nothing to split, times pool sizes from 1 to
+//the hardware concurrency, the calling thread is one of the workers
+static void WorkerArguments(benchmark::internal::Benchmark* b)
+{
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int64_t> entityCounts;
+    for (int64_t entities = 64 * minEntities; entities < maxEntities; entities *= 8)
+    {
+        entityCounts.push_back(entities);
+    }
+    entityCounts.push_back(maxEntities);
+    for (const auto entities : entityCounts)
+    {
+        for (int workers = 1; workers < hardwareThreads; workers *= 2)
+        {
+            b->Args({entities, workers});
+        }
+        b->Args({entities, hardwareThreads});
+    }
 }
 
-BENCHMARK(BM_SOA);
+//Translate, Scale and Rotate write disjoint arrays: the graph has no edge and runs them concurrently,
+//each split in ranges of 64k entities
+static void BM_SOATaskGraph(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    enum Resource : std::uint32_t { Positions, Scales, EulerAngles };
+    constexpr std::size_t grain = 64 * 1024;
+    const auto entities = static_cast<std::size_t>(state.range(0));
+    auto transformSystem = std::make_unique<TransformSystem<SOA::Vec2Layout>>(entities);
+    WorkStealingPool pool(state.range(1));
+    TaskGraph graph;
+    graph.AddSystem("Translate", {}, {Positions}, entities, grain, [&](std::size_t begin, std::size_t end)
+    {
+        transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f), begin, end);
+    });
+    graph.AddSystem("Scale", {}, {Scales}, entities, grain, [&](std::size_t begin, std::size_t end)
+    {
+        transformSystem->Scale(3.0f, begin, end);
+    });
+    graph.AddSystem("Rotate", {}, {EulerAngles}, entities, grain, [&](std::size_t begin, std::size_t end)
+    {
+        transformSystem->Rotate(45.0f, begin, end);
+    });
+    for (auto _ : allocations.Loop())
+    {
+        graph.Run(pool);
+    }
+    state.counters["steals"] = benchmark::Counter(static_cast<double>(pool.Steals()), benchmark::Counter::kAvgIterations);
+    ReportTransformThroughput(state, *transformSystem);
+}
+
+BENCH_SWEEP(BM_SOATaskGraph)->Apply(WorkerArguments)->ArgNames({"entities", "workers"})->UseRealTime();
 
 static void BM_AOSOA4(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<AOSOA::TransformSystem<4>>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<AOSOA::Layout<4>>>(state.range(0));
+    for (auto _ : allocations.Loop())
     {
         transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->Scale(3.0f);
         transformSystem->Rotate(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
 }
 
-BENCHMARK(BM_AOSOA4);
+BENCH_SWEEP(BM_AOSOA4)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
 
 #ifdef __SSE__
 static void BM_AOSOA4Intrinsics(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<AOSOA::TransformSystem<4>>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<AOSOA::Layout<4>>>(state.range(0));
+    for (auto _ : allocations.Loop())
     {
         transformSystem->TranslateInstrinsics(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->ScaleIntrinsics(3.0f);
         transformSystem->RotateIntrinsics(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
 }
 
-BENCHMARK(BM_AOSOA4Intrinsics);
+BENCH_SWEEP(BM_AOSOA4Intrinsics)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
 
 #endif
 static void BM_AOSOA8(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<AOSOA::TransformSystem<8>>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<AOSOA::Layout<8>>>(state.range(0));
+    for (auto _ : allocations.Loop())
     {
         transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->Scale(3.0f);
         transformSystem->Rotate(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
 }
 
-BENCHMARK(BM_AOSOA8);
+BENCH_SWEEP(BM_AOSOA8)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
 
 #ifdef __SSE__
 static void BM_AOSOA8Intrinsics(benchmark::State& state)
 {
-    auto transformSystem = std::make_unique<AOSOA::TransformSystem<8>>();
-    for (auto _ : state)
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<AOSOA::Layout<8>>>(state.range(0));
+    for (auto _ : allocations.Loop())
+    {
+        transformSystem->TranslateInstrinsics(sfge::Vec2f(22.0f, -4.0f));
+        transformSystem->ScaleIntrinsics(3.0f);
+        transformSystem->RotateIntrinsics(45.0f);
+    }
+    ReportTransformThroughput(state, *transformSystem);
+}
+
+BENCH_SWEEP(BM_AOSOA8Intrinsics)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
+
+#endif
+
+static void BM_SOALatency(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<SOA::Vec2Layout>>(state.range(0));
+    LatencyHistogram histogram;
+    for (auto _ : allocations.Loop())
+    {
+        LatencyScope timing(histogram);
+        transformSystem->Translate(sfge::Vec2f(22.0f, -4.0f));
+        transformSystem->Scale(3.0f);
+        transformSystem->Rotate(45.0f);
+    }
+    ReportTransformThroughput(state, *transformSystem);
+    PublishLatencyHistogram(state, histogram, "BM_SOALatency_" + std::to_string(state.range(0)));
+}
+
+BENCH_SWEEP(BM_SOALatency)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
+
+#ifdef __AVX__
+static void BM_AOSOA8IntrinsicsLatency(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    auto transformSystem = std::make_unique<TransformSystem<AOSOA::Layout<8>>>(state.range(0));
+    LatencyHistogram histogram;
+    for (auto _ : allocations.Loop())
     {
+        LatencyScope timing(histogram);
         transformSystem->TranslateInstrinsics(sfge::Vec2f(22.0f, -4.0f));
         transformSystem->ScaleIntrinsics(3.0f);
         transformSystem->RotateIntrinsics(45.0f);
     }
+    ReportTransformThroughput(state, *transformSystem);
+    PublishLatencyHistogram(state, histogram, "BM_AOSOA8IntrinsicsLatency_" + std::to_string(state.range(0)));
 }
 
-BENCHMARK(BM_AOSOA8Intrinsics);
+BENCH_SWEEP(BM_AOSOA8IntrinsicsLatency)->RangeMultiplier(8)->Range(minEntities, maxEntities)->ArgName("entities");
 
 #endif
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCH_HARNESS_MAIN();
\ No newline at end of file
@@ -3,44 +3,135 @@
 //
 
 #include <benchmark/benchmark.h>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include <vector>
+#include "intrinsics.h"
+#include "cache_topology.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
 
 const unsigned long fromRange = 8;
-const unsigned long toRange = 1<<13;
 
+//Smallest power of two side whose matrix is at least twice the LLC, narrower elements need a wider matrix
+template<typename T>
+static unsigned long MatrixToRange()
+{
+    const size_t llcElements = GetCacheTopology().LLC().size / sizeof(T);
+    unsigned long n = fromRange;
+    while (n * n < 2 * llcElements)
+    {
+        n *= 2;
+    }
+    return n;
+}
+
+template<typename T>
+static void MatrixSizes(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(2)->Range(fromRange, MatrixToRange<T>());
+}
+
+//uint8 occupancy maps, int16 heightfields, int and double fields
+template<typename T>
 class Matrix {
 public:
     Matrix(size_t n) : n(n) {
         numbers.resize(n * n);
         for (size_t i = 0; i < n; i++) {
-            numbers[i] = rand();
+            numbers[i] = static_cast<T>(rand());
         }
     }
 
-    const int& operator()(size_t x, size_t y) const {
+    const T& operator()(size_t x, size_t y) const {
 
         return numbers[x * n + y];
     }
 
-    int& operator()(size_t x, size_t y) {
+    T& operator()(size_t x, size_t y) {
 
         return numbers[x * n + y];
     }
 
+    T* row(size_t x) { return &numbers[x * n]; }
+
     const size_t size() const { return n; }
 
 private:
     size_t n;
-    std::vector<int> numbers;
+    std::vector<T> numbers;
 };
 
+//Elements and matrix bytes traversed per second, one pass over the matrix per iteration
+template<typename T>
+static void ReportTraversal(benchmark::State& state, size_t n) {
+    state.SetItemsProcessed(static_cast<int64_t>(n * n) * state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(n * n * sizeof(T)) * state.iterations());
+    state.counters["KB"] = n * n * sizeof(T) / 1024;
+}
+
+#ifdef __AVX2__
+//row[j] += j with the wrap-around of T, 32 / sizeof(T) lanes per instruction. The column indices live in a
+//register that steps by the lane count, the tail goes scalar.
+static size_t AddColumnIndicesAvx2(std::uint8_t* row, size_t n) {
+    __m256i indices = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                       16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+    const __m256i step = _mm256_set1_epi8(32);
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+        auto* p = reinterpret_cast<__m256i*>(row + j);
+        _mm256_storeu_si256(p, _mm256_add_epi8(_mm256_loadu_si256(p), indices));
+        indices = _mm256_add_epi8(indices, step);
+    }
+    return j;
+}
+
+static size_t AddColumnIndicesAvx2(std::int16_t* row, size_t n) {
+    __m256i indices = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i step = _mm256_set1_epi16(16);
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        auto* p = reinterpret_cast<__m256i*>(row + j);
+        _mm256_storeu_si256(p, _mm256_add_epi16(_mm256_loadu_si256(p), indices));
+        indices = _mm256_add_epi16(indices, step);
+    }
+    return j;
+}
+
+static size_t AddColumnIndicesAvx2(int* row, size_t n) {
+    __m256i indices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        auto* p = reinterpret_cast<__m256i*>(row + j);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), indices));
+        indices = _mm256_add_epi32(indices, step);
+    }
+    return j;
+}
 
+//Column indices are exact in double far past any matrix side
+static size_t AddColumnIndicesAvx2(double* row, size_t n) {
+    __m256d indices = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+    const __m256d step = _mm256_set1_pd(4.0);
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        _mm256_storeu_pd(row + j, _mm256_add_pd(_mm256_loadu_pd(row + j), indices));
+        indices = _mm256_add_pd(indices, step);
+    }
+    return j;
+}
+#endif
+
+template<typename T>
 static void BM_Row(benchmark::State& state) {
+    AllocationCounters allocations(state);
     const size_t n = state.range(0);
-    Matrix m(n);
-    for (auto _ : state) {
+    Matrix<T> m(n);
+    for (auto _ : allocations.Loop()) {
         for (size_t i = 0; i < m.size(); i++) {
             for (size_t j = 0; j < m.size(); j++) {
                 m(i, j) += j;
@@ -48,66 +139,110 @@ static void BM_Row(benchmark::State& state) {
         }
     }
 
-    state.counters["KB"] = n * n * sizeof(int) / 1024;
+    ReportTraversal<T>(state, n);
+}
+
+BENCH_SWEEP_TEMPLATE(BM_Row, std::uint8_t)->Apply(MatrixSizes<std::uint8_t>);
+BENCH_SWEEP_TEMPLATE(BM_Row, std::int16_t)->Apply(MatrixSizes<std::int16_t>);
+BENCH_SWEEP_TEMPLATE(BM_Row, int)->Apply(MatrixSizes<int>);
+BENCH_SWEEP_TEMPLATE(BM_Row, double)->Apply(MatrixSizes<double>);
+
+#ifdef __AVX2__
+template<typename T>
+static void BM_RowAvx2(benchmark::State& state) {
+    AllocationCounters allocations(state);
+    const size_t n = state.range(0);
+    Matrix<T> m(n);
+    for (auto _ : allocations.Loop()) {
+        for (size_t i = 0; i < m.size(); i++) {
+            T* row = m.row(i);
+            for (size_t j = AddColumnIndicesAvx2(row, n); j < n; j++) {
+                row[j] += j;
+            }
+        }
+    }
+
+    ReportTraversal<T>(state, n);
 }
 
-BENCHMARK(BM_Row)->RangeMultiplier(2)->Range(fromRange, toRange);
+BENCH_SWEEP_TEMPLATE(BM_RowAvx2, std::uint8_t)->Apply(MatrixSizes<std::uint8_t>);
+BENCH_SWEEP_TEMPLATE(BM_RowAvx2, std::int16_t)->Apply(MatrixSizes<std::int16_t>);
+BENCH_SWEEP_TEMPLATE(BM_RowAvx2, int)->Apply(MatrixSizes<int>);
+BENCH_SWEEP_TEMPLATE(BM_RowAvx2, double)->Apply(MatrixSizes<double>);
+#endif
 
 
+template<typename T>
 static void BM_Column(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     const size_t n = state.range(0);
-    Matrix m(n);
-    for (auto _ : state) {
+    Matrix<T> m(n);
+    for (auto _ : allocations.Loop()) {
         for (size_t i = 0; i < m.size(); i++) {
             for (size_t j = 0; j < m.size(); j++) {
                 m(j, i) += j;
             }
         }
     }
-    state.counters["KB"] = n * n * sizeof(int) / 1024;
+    ReportTraversal<T>(state, n);
 }
 
-BENCHMARK(BM_Column)->RangeMultiplier(2)->Range(fromRange, toRange);
+BENCH_SWEEP_TEMPLATE(BM_Column, std::uint8_t)->Apply(MatrixSizes<std::uint8_t>);
+BENCH_SWEEP_TEMPLATE(BM_Column, std::int16_t)->Apply(MatrixSizes<std::int16_t>);
+BENCH_SWEEP_TEMPLATE(BM_Column, int)->Apply(MatrixSizes<int>);
+BENCH_SWEEP_TEMPLATE(BM_Column, double)->Apply(MatrixSizes<double>);
 
+//The work goes through uint32 so that narrow T wraps around instead of converting an out of range double
+template<typename T>
 static void BM_RowWithWork(benchmark::State& state) {
+    AllocationCounters allocations(state);
     const size_t n = state.range(0);
-    Matrix m(n);
-    for (auto _ : state) {
+    Matrix<T> m(n);
+    for (auto _ : allocations.Loop()) {
         for (size_t i = 0; i < m.size(); i++) {
             for (size_t j = 0; j < m.size(); j++) {
-                m(i, j) += std::sqrt(std::hash<int>()(j*n+i));
+                m(i, j) += static_cast<T>(static_cast<std::uint32_t>(std::sqrt(std::hash<int>()(j*n+i))));
             }
         }
     }
 
-    state.counters["KB"] = n * n * sizeof(int) / 1024;
+    ReportTraversal<T>(state, n);
 }
 
-BENCHMARK(BM_RowWithWork)->RangeMultiplier(2)->Range(fromRange, toRange);
+BENCH_SWEEP_TEMPLATE(BM_RowWithWork, std::uint8_t)->Apply(MatrixSizes<std::uint8_t>);
+BENCH_SWEEP_TEMPLATE(BM_RowWithWork, std::int16_t)->Apply(MatrixSizes<std::int16_t>);
+BENCH_SWEEP_TEMPLATE(BM_RowWithWork, int)->Apply(MatrixSizes<int>);
+BENCH_SWEEP_TEMPLATE(BM_RowWithWork, double)->Apply(MatrixSizes<double>);
 
 
+template<typename T>
 static void BM_ColumnWithWork(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     const size_t n = state.range(0);
-    Matrix m(n);
-    for (auto _ : state) {
+    Matrix<T> m(n);
+    for (auto _ : allocations.Loop()) {
         for (size_t i = 0; i < m.size(); i++) {
             for (size_t j = 0; j < m.size(); j++) {
-                m(j, i) += std::sqrt(std::hash<int>()(i*n+j));
+                m(j, i) += static_cast<T>(static_cast<std::uint32_t>(std::sqrt(std::hash<int>()(i*n+j))));
             }
         }
     }
-    state.counters["KB"] = n * n * sizeof(int) / 1024;
+    ReportTraversal<T>(state, n);
 }
 
-BENCHMARK(BM_ColumnWithWork)->RangeMultiplier(2)->Range(fromRange, toRange);
+BENCH_SWEEP_TEMPLATE(BM_ColumnWithWork, std::uint8_t)->Apply(MatrixSizes<std::uint8_t>);
+BENCH_SWEEP_TEMPLATE(BM_ColumnWithWork, std::int16_t)->Apply(MatrixSizes<std::int16_t>);
+BENCH_SWEEP_TEMPLATE(BM_ColumnWithWork, int)->Apply(MatrixSizes<int>);
+BENCH_SWEEP_TEMPLATE(BM_ColumnWithWork, double)->Apply(MatrixSizes<double>);
 
 
 static void BM_Random(benchmark::State& state) {
+    AllocationCounters allocations(state);
     const size_t n = state.range(0);
-    Matrix m(n);
-    for (auto _ : state) {
+    Matrix<int> m(n);
+    for (auto _ : allocations.Loop()) {
         for (size_t i = 0; i < m.size(); i++) {
             for (size_t j = 0; j < m.size(); j++) {
                 m(j, rand() % n) += j;
@@ -115,9 +250,9 @@ static void BM_Random(benchmark::State& state) {
         }
     }
 
-    state.counters["KB"] = n * n * sizeof(int) / 1024;
+    ReportTraversal<int>(state, n);
 }
 
-BENCHMARK(BM_Random)->RangeMultiplier(2)->Range(fromRange, toRange);
+BENCH_SWEEP(BM_Random)->Apply(MatrixSizes<int>);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCH_HARNESS_MAIN();
@@ -1,27 +1,88 @@
 #include <benchmark/benchmark.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include "random_utils.h"
+#include "radix_sort.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
 
 
 const long fromRange = 8;
 
 const long toRange = 1 << 15;
 
+//Inputs come from the dataset cache, generated once and shared by every benchmark below
+static std::span<const int> RandomValues(const std::string& name, std::uint64_t seed, std::size_t length)
+{
+    return CachedDataset<int>(name, length, seed, [](std::span<int> values, std::mt19937_64& gen)
+    {
+        std::uniform_int_distribution<int> dis(0, std::numeric_limits<int>::max());
+        for (auto& value : values)
+        {
+            value = dis(gen);
+        }
+    });
+}
+
+static std::span<const std::uint8_t> RandomBits(std::size_t length)
+{
+    return CachedDataset<std::uint8_t>("branch_random_bits", length, 1, [](std::span<std::uint8_t> bits, std::mt19937_64& gen)
+    {
+        for (auto& bit : bits)
+        {
+            bit = gen() & 0x1;
+        }
+    });
+}
+
+static std::span<const std::uint8_t> InvertedBits(std::size_t length)
+{
+    return CachedDataset<std::uint8_t>("branch_inverted_bits", length, 1, [length](std::span<std::uint8_t> bits, std::mt19937_64&)
+    {
+        const auto source = RandomBits(length);
+        for (std::size_t i = 0; i < length; i++)
+        {
+            bits[i] = !source[i];
+        }
+    });
+}
+
+static std::span<const std::uint8_t> AlwaysTrue(std::size_t length)
+{
+    return CachedDataset<std::uint8_t>("branch_always_true", length, 1, [](std::span<std::uint8_t> bits, std::mt19937_64&)
+    {
+        std::fill(bits.begin(), bits.end(), 1);
+    });
+}
+
+static std::span<const std::uint8_t> Alternating(std::size_t length)
+{
+    return CachedDataset<std::uint8_t>("branch_alternating", length, 1, [](std::span<std::uint8_t> bits, std::mt19937_64&)
+    {
+        for (std::size_t i = 0; i < bits.size(); i++)
+        {
+            bits[i] = (i & 0x1) == 0;
+        }
+    });
+}
+
 
 static void BM_01_Branch_Not_Predicted(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    for(std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) & 0x1;
-    }
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0;
         for(std::size_t i = 0; i < length; i++)
@@ -42,22 +103,17 @@ static void BM_01_Branch_Not_Predicted(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Branch_Not_Predicted)->Arg(1 << 22);
+BENCH_SWEEP(BM_01_Branch_Not_Predicted)->Arg(1 << 22);
 
 static void BM_01_Branch_Predicted(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) >= 0;
-    }
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = AlwaysTrue(length);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -79,29 +135,17 @@ static void BM_01_Branch_Predicted(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Branch_Predicted)->Arg(1 << 22);
+BENCH_SWEEP(BM_01_Branch_Predicted)->Arg(1 << 22);
 
 static void BM_01_Branch_Predicted_Alt(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
-        if (i == 0)
-        {
-            c1[i] = RandomRange(0, std::numeric_limits<int>::max()) >= 0;
-        }
-        else
-        {
-            c1[i] = !c1[i - 1];
-        }
-    }
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = Alternating(length);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -123,25 +167,18 @@ static void BM_01_Branch_Predicted_Alt(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Branch_Predicted_Alt)->Arg(1 << 22);
+BENCH_SWEEP(BM_01_Branch_Predicted_Alt)->Arg(1 << 22);
 
 static void BM_02_Branch_False(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    std::vector<std::uint8_t> c2(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
-
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) & 0x1;
-        c2[i] = !c1[i];
-    }
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
+    const auto c2 = InvertedBits(length);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -163,25 +200,18 @@ static void BM_02_Branch_False(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_02_Branch_False)->Arg(1 << 22);
+BENCH_SWEEP(BM_02_Branch_False)->Arg(1 << 22);
 
 static void BM_02_Branch_False_BitWise(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    std::vector<std::uint8_t> c2(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
+    const auto c2 = InvertedBits(length);
 
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) & 0x1;
-        c2[i] = !c1[i];
-    }
-
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -203,23 +233,17 @@ static void BM_02_Branch_False_BitWise(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_02_Branch_False_BitWise)->Arg(1 << 22);
+BENCH_SWEEP(BM_02_Branch_False_BitWise)->Arg(1 << 22);
 
 static void BM_03_Branched(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
-
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) & 0x1;
-    }
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -241,23 +265,17 @@ static void BM_03_Branched(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_03_Branched)->Arg(1 << 22);
+BENCH_SWEEP(BM_03_Branched)->Arg(1 << 22);
 
 static void BM_03_Branchless(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
-    std::vector<int> v1(length);
-    std::vector<int> v2(length);
-    std::vector<std::uint8_t> c1(length);
-    for (std::size_t i = 0; i < length; i++)
-    {
-        v1[i] = RandomRange(0, std::numeric_limits<int>::max());
-        v2[i] = RandomRange(0, std::numeric_limits<int>::max());
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
 
-        c1[i] = RandomRange(0, std::numeric_limits<int>::max()) & 0x1;
-    }
-
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         int a1 = 0, a2 = 0;
         for (std::size_t i = 0; i < length; i++)
@@ -275,4 +293,86 @@ static void BM_03_Branchless(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_03_Branchless)->Arg(1 << 22);
\ No newline at end of file
+BENCH_SWEEP(BM_03_Branchless)->Arg(1 << 22);
+
+struct BranchTriple
+{
+    int v1;
+    int v2;
+    std::uint8_t c1;
+};
+
+enum BranchOrder : long
+{
+    BranchUnsorted = 0,
+    //Grouped by c1 with a radix partition before the passes
+    BranchPartitioned = 1,
+    BranchParallelPartitioned = 2,
+};
+
+//BM_01_Branch_Not_Predicted on (c1, v1, v2) triples. Each iteration pays for one partition and then runs `reuse`
+//passes over the data, so the sort cost is weighed against what the predictor wins back.
+static void BM_04_Branch_Partitioned(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t length = state.range(0);
+    const long reuse = state.range(1);
+    const auto order = static_cast<BranchOrder>(state.range(2));
+    const auto v1 = RandomValues("branch_v1", 1, length);
+    const auto v2 = RandomValues("branch_v2", 2, length);
+    const auto c1 = RandomBits(length);
+    std::vector<BranchTriple> triples(length);
+    for (std::size_t i = 0; i < length; i++)
+    {
+        triples[i] = {v1[i], v2[i], c1[i]};
+    }
+    std::vector<BranchTriple> partitioned(length);
+    std::unique_ptr<WorkStealingPool> pool;
+    if (order == BranchParallelPartitioned)
+    {
+        pool = std::make_unique<WorkStealingPool>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    for (auto _ : allocations.Loop())
+    {
+        std::span<const BranchTriple> data = triples;
+        if (order == BranchPartitioned)
+        {
+            RadixPartition<std::uint8_t, BranchTriple>(c1, triples, partitioned);
+            data = partitioned;
+        }
+        else if (order == BranchParallelPartitioned)
+        {
+            ParallelRadixPartition<std::uint8_t, BranchTriple>(*pool, c1, triples, partitioned);
+            data = partitioned;
+        }
+        for (long pass = 0; pass < reuse; pass++)
+        {
+            int a1 = 0;
+            for (const auto& triple : data)
+            {
+                if (triple.c1)
+                {
+                    a1 += triple.v1;
+                }
+                else
+                {
+                    a1 *= triple.v2;
+                }
+            }
+            benchmark::DoNotOptimize(a1);
+        }
+        benchmark::ClobberMemory();
+    }
+    static const char* orderNames[] = {"unsorted", "partitioned", "parallel_partitioned"};
+    state.SetLabel(orderNames[order]);
+    state.SetItemsProcessed(length * reuse * state.iterations());
+}
+
+BENCH_SWEEP(BM_04_Branch_Partitioned)
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 22, 16), {1, 4, 16},
+                   {BranchUnsorted, BranchPartitioned, BranchParallelPartitioned}})
+    ->ArgNames({"length", "reuse", "order"})
+    ->UseRealTime();
+
+BENCH_HARNESS_MAIN();
@@ -0,0 +1,373 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "aosoa.h"
+#include "intrinsics.h"
+#include "radix_sort.h"
+#include "task_graph.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Sort-and-sweep broadphase over the AOSOA<8> position and scale lanes of AOSOA::TransformSystem.
+//Each entity is an AABB centered on its position with its scale as half extents.
+constexpr std::size_t laneCount = 8;
+
+enum BroadphaseDistribution : long
+{
+    Uniform = 0,
+    Clustered = 1,
+};
+
+enum BroadphaseSort : long
+{
+    Radix = 0,
+    ParallelRadix = 1,
+    //Insertion sort of the previous frame's order
+    Incremental = 2,
+    StdSort = 3,
+};
+
+struct BroadphaseSample
+{
+    float positionX;
+    float positionY;
+    float halfExtent;
+    float velocityX;
+    float velocityY;
+};
+
+//World side grows with sqrt(count) so the uniform case keeps about one overlap per entity
+static std::span<const BroadphaseSample> BroadphaseDataset(std::size_t count, BroadphaseDistribution distribution)
+{
+    const float worldSize = 4.0f * std::sqrt(static_cast<float>(count));
+    return CachedDataset<BroadphaseSample>(distribution == Uniform ? "broadphase_uniform" : "broadphase_clustered",
+                                           count, 1, [=](std::span<BroadphaseSample> samples, std::mt19937_64& gen)
+    {
+        std::uniform_real_distribution<float> world(0.0f, worldSize);
+        std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+        std::uniform_real_distribution<float> velocity(-1.0f, 1.0f);
+        std::vector<std::pair<float, float>> clusters(64);
+        for (auto& cluster : clusters)
+        {
+            cluster = {world(gen), world(gen)};
+        }
+        std::normal_distribution<float> spread(0.0f, worldSize / 32.0f);
+        std::uniform_int_distribution<std::size_t> pick(0, clusters.size() - 1);
+        for (auto& sample : samples)
+        {
+            if (distribution == Uniform)
+            {
+                sample.positionX = world(gen);
+                sample.positionY = world(gen);
+            }
+            else
+            {
+                const auto& cluster = clusters[pick(gen)];
+                sample.positionX = cluster.first + spread(gen);
+                sample.positionY = cluster.second + spread(gen);
+            }
+            sample.halfExtent = extent(gen);
+            sample.velocityX = velocity(gen);
+            sample.velocityY = velocity(gen);
+        }
+    });
+}
+
+class SortAndSweep
+{
+public:
+    explicit SortAndSweep(std::size_t count)
+        : m_Keys(count), m_Order(count), m_KeyScratch(count), m_OrderScratch(count),
+          m_MinX(count + laneCount, FLT_MAX), m_MaxX(count + laneCount, FLT_MAX), m_MinY(count + laneCount, FLT_MAX),
+          m_MaxY(count + laneCount, FLT_MAX)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            m_Order[i] = static_cast<std::uint32_t>(i);
+        }
+    }
+
+    //Min-x keys in entity order, for a sort from scratch
+    void BuildKeys(std::span<const AOSOA::NPos<laneCount>> positions, std::span<const AOSOA::NScale<laneCount>> scales)
+    {
+        for (std::size_t block = 0; block < positions.size(); block++)
+        {
+            for (std::size_t lane = 0; lane < laneCount; lane++)
+            {
+                const std::size_t i = block * laneCount + lane;
+                m_Keys[i] = SortableKey(positions[block].posX[lane] - scales[block].scaleX[lane]);
+                m_Order[i] = static_cast<std::uint32_t>(i);
+            }
+        }
+    }
+
+    //Min-x keys in the previous frame's order, nearly sorted when entities move little
+    void RebuildKeys(std::span<const AOSOA::NPos<laneCount>> positions, std::span<const AOSOA::NScale<laneCount>> scales)
+    {
+        for (std::size_t i = 0; i < m_Order.size(); i++)
+        {
+            const std::uint32_t entity = m_Order[i];
+            const auto& position = positions[entity / laneCount];
+            const auto& scale = scales[entity / laneCount];
+            m_Keys[i] = SortableKey(position.posX[entity % laneCount] - scale.scaleX[entity % laneCount]);
+        }
+    }
+
+    void Sort(BroadphaseSort mode, WorkStealingPool* pool)
+    {
+        switch (mode)
+        {
+        case Radix:
+            RadixSort<std::uint32_t>(m_Keys, m_Order, m_KeyScratch, m_OrderScratch);
+            break;
+        case ParallelRadix:
+            ParallelRadixSort<std::uint32_t>(*pool, m_Keys, m_Order, m_KeyScratch, m_OrderScratch);
+            break;
+        case Incremental:
+            InsertionSort<std::uint32_t>(m_Keys, m_Order);
+            break;
+        case StdSort:
+        {
+            m_Combined.resize(m_Keys.size());
+            for (std::size_t i = 0; i < m_Keys.size(); i++)
+            {
+                m_Combined[i] = std::uint64_t{m_Keys[i]} << 32 | m_Order[i];
+            }
+            std::sort(m_Combined.begin(), m_Combined.end());
+            for (std::size_t i = 0; i < m_Keys.size(); i++)
+            {
+                m_Keys[i] = static_cast<std::uint32_t>(m_Combined[i] >> 32);
+                m_Order[i] = static_cast<std::uint32_t>(m_Combined[i]);
+            }
+            break;
+        }
+        }
+    }
+
+    //Bounds in sorted order as separate arrays, FLT_MAX padding ends every sweep
+    void GatherBounds(std::span<const AOSOA::NPos<laneCount>> positions, std::span<const AOSOA::NScale<laneCount>> scales)
+    {
+        for (std::size_t i = 0; i < m_Order.size(); i++)
+        {
+            const std::uint32_t entity = m_Order[i];
+            const auto& position = positions[entity / laneCount];
+            const auto& scale = scales[entity / laneCount];
+            const std::size_t lane = entity % laneCount;
+            m_MinX[i] = position.posX[lane] - scale.scaleX[lane];
+            m_MaxX[i] = position.posX[lane] + scale.scaleX[lane];
+            m_MinY[i] = position.posY[lane] - scale.scaleY[lane];
+            m_MaxY[i] = position.posY[lane] + scale.scaleY[lane];
+        }
+    }
+
+    std::size_t SweepScalar()
+    {
+        m_Pairs.clear();
+        const std::size_t count = m_Order.size();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            for (std::size_t j = i + 1; m_MinX[j] <= m_MaxX[i]; j++)
+            {
+                if (m_MinY[j] <= m_MaxY[i] && m_MinY[i] <= m_MaxY[j])
+                {
+                    m_Pairs.emplace_back(m_Order[i], m_Order[j]);
+                }
+            }
+        }
+        return m_Pairs.size();
+    }
+
+#ifdef __AVX__
+    //Tests 8 candidates per compare, candidates are sorted by min x so the x mask is a prefix
+    std::size_t SweepAvx()
+    {
+        m_Pairs.clear();
+        const std::size_t count = m_Order.size();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const __m256 maxX = _mm256_set1_ps(m_MaxX[i]);
+            const __m256 minY = _mm256_set1_ps(m_MinY[i]);
+            const __m256 maxY = _mm256_set1_ps(m_MaxY[i]);
+            for (std::size_t j = i + 1;; j += laneCount)
+            {
+                const int xMask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(&m_MinX[j]), maxX, _CMP_LE_OQ));
+                const __m256 yOverlap = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&m_MinY[j]), maxY, _CMP_LE_OQ),
+                                                      _mm256_cmp_ps(minY, _mm256_loadu_ps(&m_MaxY[j]), _CMP_LE_OQ));
+                auto mask = static_cast<unsigned>(xMask & _mm256_movemask_ps(yOverlap));
+                while (mask != 0)
+                {
+                    m_Pairs.emplace_back(m_Order[i], m_Order[j + std::countr_zero(mask)]);
+                    mask &= mask - 1;
+                }
+                if (xMask != 0xFF)
+                {
+                    break;
+                }
+            }
+        }
+        return m_Pairs.size();
+    }
+#endif
+
+    [[nodiscard]] const std::vector<std::pair<std::uint32_t, std::uint32_t>>& Pairs() const { return m_Pairs; }
+
+private:
+    std::vector<std::uint32_t> m_Keys;
+    std::vector<std::uint32_t> m_Order;
+    std::vector<std::uint32_t> m_KeyScratch;
+    std::vector<std::uint32_t> m_OrderScratch;
+    std::vector<std::uint64_t> m_Combined;
+    std::vector<float> m_MinX;
+    std::vector<float> m_MaxX;
+    std::vector<float> m_MinY;
+    std::vector<float> m_MaxY;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> m_Pairs;
+};
+
+//One frame: move, sort on min x, sweep. The incremental mode sorts once during setup.
+static void BM_Broadphase(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = (static_cast<std::size_t>(state.range(0)) + laneCount - 1) / laneCount * laneCount;
+    const auto distribution = static_cast<BroadphaseDistribution>(state.range(1));
+    const auto sortMode = static_cast<BroadphaseSort>(state.range(2));
+    const bool simd = state.range(3) != 0;
+#ifndef __AVX__
+    if (simd)
+    {
+        state.SkipWithError("built without AVX");
+        return;
+    }
+#endif
+
+    std::vector<AOSOA::NPos<laneCount>> positions(count / laneCount);
+    std::vector<AOSOA::NScale<laneCount>> scales(count / laneCount);
+    std::vector<AOSOA::NPos<laneCount>> velocities(count / laneCount);
+    const auto samples = BroadphaseDataset(count, distribution);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::size_t block = i / laneCount;
+        const std::size_t lane = i % laneCount;
+        positions[block].posX[lane] = samples[i].positionX;
+        positions[block].posY[lane] = samples[i].positionY;
+        scales[block].scaleX[lane] = samples[i].halfExtent;
+        scales[block].scaleY[lane] = samples[i].halfExtent;
+        velocities[block].posX[lane] = samples[i].velocityX;
+        velocities[block].posY[lane] = samples[i].velocityY;
+    }
+
+    std::unique_ptr<WorkStealingPool> pool;
+    if (sortMode == ParallelRadix)
+    {
+        pool = std::make_unique<WorkStealingPool>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    SortAndSweep broadphase(count);
+    broadphase.BuildKeys(positions, scales);
+    broadphase.Sort(Radix, nullptr);
+    //Warm the pair buffer so the timed frames do not grow it
+    broadphase.GatherBounds(positions, scales);
+    broadphase.SweepScalar();
+
+    constexpr float dt = 1.0f / 60.0f;
+    std::size_t pairs = 0;
+    for (auto _ : allocations.Loop())
+    {
+        for (std::size_t block = 0; block < positions.size(); block++)
+        {
+            for (std::size_t lane = 0; lane < laneCount; lane++)
+            {
+                positions[block].posX[lane] += velocities[block].posX[lane] * dt;
+                positions[block].posY[lane] += velocities[block].posY[lane] * dt;
+            }
+        }
+        if (sortMode == Incremental)
+        {
+            broadphase.RebuildKeys(positions, scales);
+        }
+        else
+        {
+            broadphase.BuildKeys(positions, scales);
+        }
+        broadphase.Sort(sortMode, pool.get());
+        broadphase.GatherBounds(positions, scales);
+#ifdef __AVX__
+        pairs += simd ? broadphase.SweepAvx() : broadphase.SweepScalar();
+#else
+        pairs += broadphase.SweepScalar();
+#endif
+        benchmark::DoNotOptimize(broadphase.Pairs().data());
+    }
+
+    static const char* distributionNames[] = {"uniform", "clustered"};
+    static const char* sortNames[] = {"radix", "parallel_radix", "incremental", "std_sort"};
+    state.SetLabel(std::string(distributionNames[distribution]) + " " + sortNames[sortMode] +
+                   (simd ? " avx" : " scalar"));
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.counters["pairs"] = benchmark::Counter(static_cast<double>(pairs), benchmark::Counter::kAvgIterations);
+    state.counters["pairs_per_second"] = benchmark::Counter(static_cast<double>(pairs), benchmark::Counter::kIsRate);
+}
+
+BENCH_SWEEP(BM_Broadphase)
+    ->ArgsProduct({{1 << 20}, {Uniform, Clustered}, {Radix, ParallelRadix, Incremental, StdSort}, {0, 1}})
+    ->ArgNames({"entities", "distribution", "sort", "simd"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+//Sort alone on the min-x keys of the uniform set
+static void BM_BroadphaseSort(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const auto sortMode = static_cast<BroadphaseSort>(state.range(1));
+    const auto samples = BroadphaseDataset(count, Uniform);
+    std::vector<std::uint32_t> sourceKeys(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        sourceKeys[i] = SortableKey(samples[i].positionX - samples[i].halfExtent);
+    }
+    std::vector<std::uint32_t> keys(count);
+    std::vector<std::uint32_t> order(count);
+    std::vector<std::uint32_t> keyScratch(count);
+    std::vector<std::uint32_t> orderScratch(count);
+    WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto _ : allocations.Loop())
+    {
+        state.PauseTiming();
+        keys = sourceKeys;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            order[i] = static_cast<std::uint32_t>(i);
+        }
+        state.ResumeTiming();
+        if (sortMode == ParallelRadix)
+        {
+            ParallelRadixSort<std::uint32_t>(pool, keys, order, keyScratch, orderScratch);
+        }
+        else
+        {
+            RadixSort<std::uint32_t>(keys, order, keyScratch, orderScratch);
+        }
+        benchmark::DoNotOptimize(keys.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.SetLabel(sortMode == ParallelRadix ? "parallel_radix" : "radix");
+}
+
+BENCH_SWEEP(BM_BroadphaseSort)
+    ->ArgsProduct({benchmark::CreateRange(1 << 14, 1 << 22, 4), {Radix, ParallelRadix}})
+    ->ArgNames({"keys", "sort"})
+    ->UseRealTime();
+
+BENCH_HARNESS_MAIN();
@@ -6,21 +6,33 @@
 #include <benchmark/benchmark.h>
 #include <vector>
 #include <random>
+#include <chrono>
 #include "random_utils.h"
+#include "cache_topology.h"
+#include "intrinsics.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
 
 constexpr long fromRange = 8;
 
 constexpr long toRange = 1 << 15;
 
+static std::string SizeLabel(std::size_t bytes)
+{
+    return bytes/1024 > 1000?std::to_string(bytes/1024/1024)+"mb":std::to_string(bytes/1024)+"kb";
+}
+
 static void BM_RandomCacheBench(benchmark::State &state)
 {
+    AllocationCounters allocations(state);
     const std::size_t bytes = 1u << state.range(0);
     const std::size_t count = (bytes/sizeof(int))/2u;
     std::vector<int> v(count);
     RandomFill(v, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
     std::vector<int> indices(count);
-    RandomFill(indices, 0, static_cast<int>(count));
-    for(auto _ : state)
+    RandomFill(indices, 0, static_cast<int>(count) - 1);
+    for(auto _ : allocations.Loop())
     {
         long sum = 0;
         for(const auto i : indices)
@@ -30,7 +42,168 @@ static void BM_RandomCacheBench(benchmark::State &state)
         benchmark::DoNotOptimize(sum);
     }
     state.SetBytesProcessed(static_cast<std::size_t>(state.iterations())* static_cast<std::size_t>(bytes));
-    state.SetLabel(bytes/1024 > 1000?std::to_string(bytes/1024/1024)+"mb":std::to_string(bytes/1024)+"kb");
+    state.SetLabel(SizeLabel(bytes));
+
+}
+//From a quarter of L1 to four times the LLC, never narrower than the original 8kb..64mb sweep
+static void CacheSweepArguments(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    const int from = std::min(13, Log2Floor(topology.L1().size) - 2);
+    const int to = std::max(26, Log2Ceil(topology.LLC().size) + 2);
+    b->DenseRange(from, to);
+}
+BENCH_SWEEP(BM_RandomCacheBench)->Apply(CacheSweepArguments)->DisplayAggregatesOnly(true);
+
+//Same gather as BM_RandomCacheBench, issuing a prefetch for the element distance lookups ahead
+static long SumPrefetch(const std::vector<int>& v, const std::vector<int>& indices, std::size_t distance)
+{
+    long sum = 0;
+    const std::size_t count = indices.size();
+    const std::size_t prefetched = count > distance ? count - distance : 0;
+    std::size_t i = 0;
+    for (; i < prefetched; i++)
+    {
+        _mm_prefetch(reinterpret_cast<const char*>(&v[indices[i + distance]]), _MM_HINT_T0);
+        sum += v[indices[i]];
+    }
+    for (; i < count; i++)
+    {
+        sum += v[indices[i]];
+    }
+    return sum;
+}
+
+struct PrefetchTuning
+{
+    std::size_t distance = 0;
+    double plainNs = 0.0;
+    double bestNs = 0.0;
+};
+
+//Times one pass per candidate distance (best of three), distance 0 being the plain loop
+static PrefetchTuning TunePrefetchDistance(const std::vector<int>& v, const std::vector<int>& indices)
+{
+    static constexpr std::size_t candidates[] = {0, 2, 4, 8, 16, 32, 64, 128, 256};
+    PrefetchTuning tuning;
+    for (const std::size_t distance : candidates)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int repeat = 0; repeat < 3; repeat++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            long sum = distance == 0 ? SumPrefetch(v, indices, indices.size()) : SumPrefetch(v, indices, distance);
+            benchmark::DoNotOptimize(sum);
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        if (distance == 0)
+        {
+            tuning.plainNs = best;
+            tuning.bestNs = best;
+        }
+        else if (best < tuning.bestNs)
+        {
+            tuning.distance = distance;
+            tuning.bestNs = best;
+        }
+    }
+    return tuning;
+}
+
+static void BM_RandomCacheGather(benchmark::State &state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = 1u << state.range(0);
+    const std::size_t count = (bytes/sizeof(int))/2u;
+    std::vector<int> v(count);
+    RandomFill(v, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> indices(count);
+    RandomFill(indices, 0, static_cast<int>(count) - 1);
+    for(auto _ : allocations.Loop())
+    {
+        __m256i acc = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&indices[i]));
+            acc = _mm256_add_epi32(acc, _mm256_i32gather_epi32(v.data(), index, sizeof(int)));
+        }
+        long sum = 0;
+        for(; i < count; i++)
+        {
+            sum += v[indices[i]];
+        }
+        benchmark::DoNotOptimize(acc);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(static_cast<std::size_t>(state.iterations())* static_cast<std::size_t>(bytes));
+    state.SetLabel(SizeLabel(bytes));
+}
 
+static void BM_RandomCachePrefetch(benchmark::State &state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = 1u << state.range(0);
+    const std::size_t distance = state.range(1);
+    const std::size_t count = (bytes/sizeof(int))/2u;
+    std::vector<int> v(count);
+    RandomFill(v, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> indices(count);
+    RandomFill(indices, 0, static_cast<int>(count) - 1);
+    for(auto _ : allocations.Loop())
+    {
+        long sum = SumPrefetch(v, indices, distance);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(static_cast<std::size_t>(state.iterations())* static_cast<std::size_t>(bytes));
+    state.SetLabel(SizeLabel(bytes));
 }
-BENCHMARK(BM_RandomCacheBench)->DenseRange(13, 26)->ReportAggregatesOnly(true);
\ No newline at end of file
+
+//Runs with the distance picked by the autotuner and reports it with the speedup over the plain loop
+static void BM_RandomCachePrefetchTuned(benchmark::State &state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = 1u << state.range(0);
+    const std::size_t count = (bytes/sizeof(int))/2u;
+    std::vector<int> v(count);
+    RandomFill(v, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> indices(count);
+    RandomFill(indices, 0, static_cast<int>(count) - 1);
+    const PrefetchTuning tuning = TunePrefetchDistance(v, indices);
+    const std::size_t distance = tuning.distance == 0 ? count : tuning.distance;
+    for(auto _ : allocations.Loop())
+    {
+        long sum = SumPrefetch(v, indices, distance);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(static_cast<std::size_t>(state.iterations())* static_cast<std::size_t>(bytes));
+    state.counters["distance"] = static_cast<double>(tuning.distance);
+    state.counters["speedup"] = tuning.plainNs / tuning.bestNs;
+    state.SetLabel(SizeLabel(bytes));
+}
+
+//From the L2 size up to well past the LLC
+static void PrefetchSweepArguments(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    b->DenseRange(Log2Floor(topology.L2().size), std::max(26, Log2Ceil(topology.LLC().size) + 2));
+}
+
+static void PrefetchDistanceArguments(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    for (int size = Log2Floor(topology.L2().size); size <= std::max(26, Log2Ceil(topology.LLC().size) + 2); size++)
+    {
+        for (const long distance : {4, 16, 64})
+        {
+            b->Args({size, distance});
+        }
+    }
+}
+
+BENCH_SWEEP(BM_RandomCacheGather)->Apply(PrefetchSweepArguments)->DisplayAggregatesOnly(true);
+BENCH_SWEEP(BM_RandomCachePrefetch)->Apply(PrefetchDistanceArguments)->DisplayAggregatesOnly(true);
+BENCH_SWEEP(BM_RandomCachePrefetchTuned)->Apply(PrefetchSweepArguments)->DisplayAggregatesOnly(true);
+
+BENCH_HARNESS_MAIN();
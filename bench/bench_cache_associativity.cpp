@@ -6,12 +6,28 @@
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include "cache_topology.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
 
-const unsigned long fromRange = 32;
-const unsigned long toRange = 300;
+//Strides in ints, from one cache line up to twice the L1 critical stride
+static const size_t fromRange = GetCacheTopology().LineSize() / sizeof(int);
+static const size_t toRange = 2 * GetCacheTopology().L1().CriticalStride() / sizeof(int);
 
-static int* v = nullptr;
-static constexpr size_t length = 1024*1024; //4MB
+//At least 4MB and large enough to spill out of L2
+static const size_t length = std::max<size_t>(4 * 1024 * 1024, 4 * GetCacheTopology().L2().size) / sizeof(int);
+
+//Filled on first use so the driver binary does not pay for it unless BM_Step runs
+static int* StepData()
+{
+    static std::vector<int> numbers = [] {
+        std::vector<int> values(length);
+        std::generate(values.begin(), values.end(), [](){ return rand(); });
+        return values;
+    }();
+    return numbers.data();
+}
 
 
 
@@ -29,9 +45,11 @@ static void CustomArguments(benchmark::internal::Benchmark* b) {
 }
 
 static void BM_Step(benchmark::State& state) {
+    AllocationCounters allocations(state);
     const size_t step = state.range(0);
+    int* v = StepData();
     size_t i = 0;
-    for (auto _ : state) {
+    for (auto _ : allocations.Loop()) {
         for(size_t repeat = 0; repeat < 10000; ++repeat)
         {
             v[i]++;
@@ -40,12 +58,17 @@ static void BM_Step(benchmark::State& state) {
     }
 }
 
-BENCHMARK(BM_Step)->Apply(CustomArguments);
+BENCH_SWEEP(BM_Step)->Apply(CustomArguments);
 
+#ifndef BENCH_DRIVER
 int main(int argc, char** argv) {
-    std::vector<int> numbers(length);
-    std::generate(numbers.begin(), numbers.end(),[](){ return rand();});
-    v = numbers.data();
+    AddCacheTopologyContext();
+    const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv);
+    if (!ConfigureSweeps(argc, argv))
+    {
+        return 1;
+    }
     benchmark::Initialize(&argc, argv);
-    benchmark::RunSpecifiedBenchmarks();
-}
\ No newline at end of file
+    RunHarnessedBenchmarks(harnessOptions);
+}
+#endif
@@ -0,0 +1,100 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "cache_topology.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+static void BM_PointerChase(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = 1u << state.range(0);
+    const std::size_t stride = GetCacheTopology().LineSize();
+    const std::size_t slotWords = stride / sizeof(std::size_t);
+    const std::size_t count = bytes / stride;
+    std::vector<std::size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(42);
+    std::shuffle(order.begin() + 1, order.end(), gen);
+    std::vector<std::size_t> nodes(count * slotWords);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        nodes[order[i] * slotWords] = order[(i + 1) % count] * slotWords;
+    }
+
+    std::size_t index = 0;
+    for (auto _ : allocations.Loop())
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            index = nodes[index];
+        }
+        benchmark::DoNotOptimize(index);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.counters["ns_per_load"] = benchmark::Counter(static_cast<double>(count) * state.iterations(),
+                                                       benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.SetLabel(cache_topology_detail::FormatBytes(bytes));
+}
+
+static void ChaseArguments(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    b->DenseRange(12, Log2Ceil(topology.LLC().size) + 2);
+}
+BENCH_SWEEP(BM_PointerChase)->Apply(ChaseArguments);
+
+#ifndef BENCH_DRIVER
+//Usage: bench_cache_topology [--topology_json=<file>] [--topology_skip_probe] [benchmark flags]
+int main(int argc, char** argv)
+{
+    const char* jsonPath = nullptr;
+    bool probe = true;
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "--topology_json=", 16) == 0)
+        {
+            jsonPath = argv[i] + 16;
+        }
+        else if (std::strcmp(argv[i], "--topology_skip_probe") == 0)
+        {
+            probe = false;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    CacheTopology topology = GetCacheTopology();
+    if (probe)
+    {
+        topology.probe = ProbeCacheTopology(topology);
+    }
+    WriteCacheTopologyReport(std::cout, topology);
+    if (jsonPath != nullptr)
+    {
+        std::ofstream json(jsonPath);
+        WriteCacheTopologyJson(json, topology);
+    }
+    AddCacheTopologyContext(topology);
+
+    const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv);
+    if (!ConfigureSweeps(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    RunHarnessedBenchmarks(harnessOptions);
+    benchmark::Shutdown();
+    return 0;
+}
+#endif
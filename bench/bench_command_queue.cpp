@@ -0,0 +1,367 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aosoa.h"
+#include "command_queue.h"
+#include "cycle_clock.h"
+#include "latency_histogram.h"
+#include "radix_sort.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Producer threads (network, AI) send per-entity move and scale commands to the transform update. Every frame
+//the update thread drains the rings, sorts the commands by entity, folds the commands of each entity into one
+//delta and scatters the deltas into the SoA or AOSOA arrays.
+namespace
+{
+enum class CommandKind : std::uint32_t
+{
+    Move,
+    Scale,
+};
+
+struct TransformCommand
+{
+    std::uint32_t entity;
+    CommandKind kind;
+    float x;
+    float y;
+    //ReadCycles() when the batch was pushed
+    std::uint64_t issued;
+};
+
+//Moves add up and scales multiply. They write different arrays, so their relative order does not matter.
+struct EntityDelta
+{
+    std::uint32_t entity;
+    float moveX;
+    float moveY;
+    float scaleX;
+    float scaleY;
+};
+
+enum CommandQueueKind : long
+{
+    //One SpscRing per producer
+    SpscPerProducer = 0,
+    //One MpscRing shared by every producer
+    SharedMpsc = 1,
+};
+
+enum CommandLayout : long
+{
+    SoaLayout = 0,
+    AosoaLayout = 1,
+};
+
+constexpr std::size_t commandEntities = 1 << 20;
+//Commands only target the first entities, so an entity often gets several commands in one frame
+constexpr std::uint32_t activeEntities = 1 << 11;
+//A frame waits for at least this many commands, about 0.63 deltas per command over activeEntities
+constexpr std::size_t frameCommands = 1 << 11;
+constexpr std::size_t commandBatch = 64;
+//Split evenly between the SPSC rings, so the queued commands a latency can wait behind do not grow with producers
+constexpr std::size_t totalRingCapacity = 1 << 16;
+constexpr std::size_t laneCount = 8;
+
+class CommandQueues
+{
+public:
+    CommandQueues(CommandQueueKind kind, std::size_t producers)
+    {
+        if (kind == SpscPerProducer)
+        {
+            for (std::size_t i = 0; i < producers; i++)
+            {
+                m_Spsc.push_back(std::make_unique<SpscRing<TransformCommand>>(totalRingCapacity / producers));
+            }
+        }
+        else
+        {
+            m_Mpsc = std::make_unique<MpscRing<TransformCommand>>(totalRingCapacity);
+        }
+    }
+
+    std::size_t TryPush(std::size_t producer, std::span<const TransformCommand> commands)
+    {
+        return m_Mpsc ? m_Mpsc->TryPush(commands) : m_Spsc[producer]->TryPush(commands);
+    }
+
+    //At most Capacity() commands
+    std::size_t Drain(std::span<TransformCommand> commands)
+    {
+        if (m_Mpsc)
+        {
+            return m_Mpsc->TryPop(commands);
+        }
+        std::size_t count = 0;
+        for (auto& ring : m_Spsc)
+        {
+            count += ring->TryPop(commands.subspan(count));
+        }
+        return count;
+    }
+
+    [[nodiscard]] std::size_t Capacity() const
+    {
+        if (m_Mpsc)
+        {
+            return m_Mpsc->Capacity();
+        }
+        std::size_t capacity = 0;
+        for (const auto& ring : m_Spsc)
+        {
+            capacity += ring->Capacity();
+        }
+        return capacity;
+    }
+
+private:
+    std::vector<std::unique_ptr<SpscRing<TransformCommand>>> m_Spsc;
+    std::unique_ptr<MpscRing<TransformCommand>> m_Mpsc;
+};
+
+//Sends batches at commandsPerSecond split evenly between the producers, with the time of the push in every
+//command. A producer that fell behind, e.g. on a full ring, catches up in a burst. 0 pushes as fast as the rings
+//take the batches, the latency is then only the ring capacity over the drain rate.
+class CommandProducers
+{
+public:
+    CommandProducers(CommandQueues& queues, std::size_t producers, std::int64_t commandsPerSecond)
+    {
+        const auto batchInterval = commandsPerSecond > 0
+            ? std::chrono::nanoseconds(static_cast<std::int64_t>(1e9 * static_cast<double>(commandBatch * producers) /
+                                                                 static_cast<double>(commandsPerSecond)))
+            : std::chrono::nanoseconds(0);
+        for (std::size_t i = 0; i < producers; i++)
+        {
+            m_Threads.emplace_back([this, &queues, i, batchInterval] { Produce(queues, i, batchInterval); });
+        }
+    }
+    ~CommandProducers()
+    {
+        m_Stop.store(true, std::memory_order_relaxed);
+        for (auto& thread : m_Threads)
+        {
+            thread.join();
+        }
+    }
+    CommandProducers(const CommandProducers&) = delete;
+    CommandProducers& operator=(const CommandProducers&) = delete;
+
+private:
+    void Produce(CommandQueues& queues, std::size_t producer, std::chrono::nanoseconds batchInterval)
+    {
+        std::minstd_rand gen(static_cast<std::uint32_t>(producer + 1));
+        std::uniform_int_distribution<std::uint32_t> entity(0, activeEntities - 1);
+        std::array<TransformCommand, commandBatch> batch;
+        auto due = std::chrono::steady_clock::now();
+        while (!m_Stop.load(std::memory_order_relaxed))
+        {
+            if (batchInterval.count() > 0)
+            {
+                std::this_thread::sleep_until(due);
+                due += batchInterval;
+            }
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                batch[i] = i % 2 == 0 ? TransformCommand{entity(gen), CommandKind::Move, 0.5f, -0.25f, 0}
+                                      : TransformCommand{entity(gen), CommandKind::Scale, 1.001f, 0.999f, 0};
+            }
+            const std::uint64_t issued = ReadCycles();
+            for (auto& command : batch)
+            {
+                command.issued = issued;
+            }
+            std::span<const TransformCommand> pending(batch);
+            while (!pending.empty() && !m_Stop.load(std::memory_order_relaxed))
+            {
+                pending = pending.subspan(queues.TryPush(producer, pending));
+                if (!pending.empty())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> m_Threads;
+    std::atomic<bool> m_Stop{false};
+};
+
+//Commands must be sorted by entity, returns the number of deltas
+std::size_t CoalesceCommands(std::span<const TransformCommand> commands, std::span<EntityDelta> deltas)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < commands.size();)
+    {
+        EntityDelta delta{commands[i].entity, 0.0f, 0.0f, 1.0f, 1.0f};
+        for (; i < commands.size() && commands[i].entity == delta.entity; i++)
+        {
+            if (commands[i].kind == CommandKind::Move)
+            {
+                delta.moveX += commands[i].x;
+                delta.moveY += commands[i].y;
+            }
+            else
+            {
+                delta.scaleX *= commands[i].x;
+                delta.scaleY *= commands[i].y;
+            }
+        }
+        deltas[count++] = delta;
+    }
+    return count;
+}
+
+struct SoaTransforms
+{
+    std::vector<float> positionX = std::vector<float>(commandEntities);
+    std::vector<float> positionY = std::vector<float>(commandEntities);
+    std::vector<float> scaleX = std::vector<float>(commandEntities, 1.0f);
+    std::vector<float> scaleY = std::vector<float>(commandEntities, 1.0f);
+
+    void Apply(std::span<const EntityDelta> deltas)
+    {
+        for (const auto& delta : deltas)
+        {
+            positionX[delta.entity] += delta.moveX;
+            positionY[delta.entity] += delta.moveY;
+            scaleX[delta.entity] *= delta.scaleX;
+            scaleY[delta.entity] *= delta.scaleY;
+        }
+    }
+};
+
+struct AosoaTransforms
+{
+    std::vector<AOSOA::NPos<laneCount>> positions = std::vector<AOSOA::NPos<laneCount>>(commandEntities / laneCount);
+    std::vector<AOSOA::NScale<laneCount>> scales = std::vector<AOSOA::NScale<laneCount>>(commandEntities / laneCount);
+
+    AosoaTransforms()
+    {
+        for (auto& scale : scales)
+        {
+            scale.scaleX.fill(1.0f);
+            scale.scaleY.fill(1.0f);
+        }
+    }
+
+    //Deltas are sorted, consecutive entities share a block
+    void Apply(std::span<const EntityDelta> deltas)
+    {
+        for (const auto& delta : deltas)
+        {
+            auto& position = positions[delta.entity / laneCount];
+            auto& scale = scales[delta.entity / laneCount];
+            const std::size_t lane = delta.entity % laneCount;
+            position.posX[lane] += delta.moveX;
+            position.posY[lane] += delta.moveY;
+            scale.scaleX[lane] *= delta.scaleX;
+            scale.scaleY[lane] *= delta.scaleY;
+        }
+    }
+};
+}
+
+//One iteration is one update frame of at least frameCommands commands, the wait for them is not timed. With
+//range(3) at 0 the producers are unpaced and commands_per_second is the throughput of the update thread. With a
+//paced rate (below the drain rate) the latency (push to applied, in cycles) is the wait for the frame to fill
+//plus the frame itself, not the time to drain a full ring. The rates can be changed with the product key of the
+//sweep config.
+static void BM_CommandQueue(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const auto producers = static_cast<std::size_t>(state.range(0));
+    const auto queueKind = static_cast<CommandQueueKind>(state.range(1));
+    const auto layout = static_cast<CommandLayout>(state.range(2));
+    const std::int64_t commandsPerSecond = state.range(3);
+
+    CommandQueues queues(queueKind, producers);
+    const std::size_t maxCommands = queues.Capacity();
+    std::vector<TransformCommand> commands(maxCommands);
+    std::vector<TransformCommand> commandScratch(maxCommands);
+    std::vector<std::uint32_t> keys(maxCommands);
+    std::vector<std::uint32_t> keyScratch(maxCommands);
+    std::vector<EntityDelta> deltas(maxCommands);
+    SoaTransforms soa;
+    AosoaTransforms aosoa;
+    LatencyHistogram histogram;
+    std::size_t applied = 0;
+    std::size_t coalesced = 0;
+
+    CommandProducers producerThreads(queues, producers, commandsPerSecond);
+    for (auto _ : allocations.Loop())
+    {
+        std::size_t count = queues.Drain(commands);
+        if (count < frameCommands)
+        {
+            state.PauseTiming();
+            while (count < frameCommands)
+            {
+                const std::size_t drained = queues.Drain(std::span(commands).subspan(count));
+                if (drained == 0)
+                {
+                    std::this_thread::yield();
+                }
+                count += drained;
+            }
+            state.ResumeTiming();
+        }
+        const std::span<TransformCommand> drained(commands.data(), count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            keys[i] = drained[i].entity;
+        }
+        RadixSort<TransformCommand>(std::span(keys).first(count), drained, std::span(keyScratch).first(count),
+                                    std::span(commandScratch).first(count));
+        const std::size_t deltaCount = CoalesceCommands(drained, deltas);
+        if (layout == SoaLayout)
+        {
+            soa.Apply(std::span(deltas).first(deltaCount));
+        }
+        else
+        {
+            aosoa.Apply(std::span(deltas).first(deltaCount));
+        }
+
+        const std::uint64_t now = ReadCycles();
+        state.PauseTiming();
+        for (const auto& command : drained)
+        {
+            histogram.Record(now - command.issued);
+        }
+        state.ResumeTiming();
+        applied += count;
+        coalesced += deltaCount;
+    }
+
+    static const char* queueNames[] = {"spsc", "mpsc"};
+    static const char* layoutNames[] = {"soa", "aosoa"};
+    state.SetLabel(std::string(queueNames[queueKind]) + " " + layoutNames[layout]);
+    state.SetItemsProcessed(static_cast<int64_t>(applied));
+    state.counters["commands_per_second"] =
+        benchmark::Counter(static_cast<double>(applied), benchmark::Counter::kIsRate);
+    state.counters["deltas_per_command"] =
+        applied == 0 ? 0.0 : static_cast<double>(coalesced) / static_cast<double>(applied);
+    PublishLatencyHistogram(state, histogram, "BM_CommandQueue_" + std::to_string(producers) + "_" +
+                                                  queueNames[queueKind] + "_" + layoutNames[layout] + "_" +
+                                                  std::to_string(commandsPerSecond));
+}
+
+//Unpaced for the throughput, then 1M and 4M commands per second, a fraction of what one update thread drains
+BENCH_SWEEP(BM_CommandQueue)
+    ->ArgsProduct({{1, 2, 4, 8}, {SpscPerProducer, SharedMpsc}, {SoaLayout, AosoaLayout}, {0, 1 << 20, 1 << 22}})
+    ->ArgNames({"producers", "queue", "layout", "rate"})
+    ->UseRealTime();
+
+BENCH_HARNESS_MAIN();
@@ -0,0 +1,393 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+#include "ecs.h"
+#include "task_graph.h"
+#include "vectorize_guard.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Local to this suite, bench_driver links it with the other suites
+namespace
+{
+struct Position
+{
+    float x;
+    float y;
+};
+
+struct Scale
+{
+    float x;
+    float y;
+};
+
+struct Rotation
+{
+    float eulerAngle;
+};
+
+struct Velocity
+{
+    float x;
+    float y;
+};
+
+struct Health
+{
+    float value;
+    float regeneration;
+};
+
+struct AiState
+{
+    std::uint32_t state;
+    float timer;
+};
+
+//Tag-like component toggled by the structural change benchmark
+struct Stunned
+{
+    float remaining;
+};
+}
+
+struct EntitySample
+{
+    float positionX;
+    float positionY;
+    float scale;
+    float eulerAngle;
+    float velocityX;
+    float velocityY;
+    //Bit 0 velocity, bit 1 health, bit 2 AI
+    std::uint32_t components;
+};
+
+static std::span<const EntitySample> EntityDataset(std::size_t count)
+{
+    return CachedDataset<EntitySample>("ecs_entities", count, 1, [](std::span<EntitySample> samples, std::mt19937_64& gen)
+    {
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_int_distribution<std::uint32_t> components(0, 7);
+        for (auto& sample : samples)
+        {
+            sample = {position(gen), position(gen), 1.0f + unit(gen) * 0.5f, unit(gen) * 3.14159f, unit(gen),
+                      unit(gen), components(gen)};
+        }
+    });
+}
+
+//Every entity has a transform, the optional components spread them over 8 archetypes in random order
+static std::vector<ecs::Entity> PopulateWorld(ecs::World& world, std::size_t count)
+{
+    std::vector<ecs::Entity> entities;
+    entities.reserve(count);
+    world.Reserve(count);
+    for (const auto& sample : EntityDataset(count))
+    {
+        const Position position{sample.positionX, sample.positionY};
+        const Scale scale{sample.scale, sample.scale};
+        const Rotation rotation{sample.eulerAngle};
+        const ecs::Entity entity = world.Create(position, scale, rotation);
+        if ((sample.components & 1) != 0)
+        {
+            world.Add(entity, Velocity{sample.velocityX, sample.velocityY});
+        }
+        if ((sample.components & 2) != 0)
+        {
+            world.Add(entity, Health{50.0f, 0.5f});
+        }
+        if ((sample.components & 4) != 0)
+        {
+            world.Add(entity, AiState{0, 0.0f});
+        }
+        entities.push_back(entity);
+    }
+    return entities;
+}
+
+//Systems take a range of the chunks their query matches so the task graph can split them
+constexpr std::size_t allChunks = std::numeric_limits<std::size_t>::max();
+
+static void TranslateSystem(ecs::World& world, float x, float y, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<Position>(begin, end, [=](std::span<Position> positions)
+    {
+        VECTORIZE_GUARD_BEGIN("ecs::TranslateSystem", "sse");
+        for (auto& position : positions)
+        {
+            position.x += x;
+            position.y += y;
+        }
+        VECTORIZE_GUARD_END("ecs::TranslateSystem");
+    });
+}
+
+static void ScaleSystem(ecs::World& world, float value, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<Scale>(begin, end, [=](std::span<Scale> scales)
+    {
+        for (auto& scale : scales)
+        {
+            scale.x *= value;
+            scale.y *= value;
+        }
+    });
+}
+
+static void RotateSystem(ecs::World& world, float angle, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<Rotation>(begin, end, [=](std::span<Rotation> rotations)
+    {
+        for (auto& rotation : rotations)
+        {
+            rotation.eulerAngle += angle;
+        }
+    });
+}
+
+static void MoveSystem(ecs::World& world, float dt, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<Position, const Velocity>(begin, end,
+                                                 [=](std::span<Position> positions, std::span<const Velocity> velocities)
+    {
+        for (std::size_t i = 0; i < positions.size(); i++)
+        {
+            positions[i].x += velocities[i].x * dt;
+            positions[i].y += velocities[i].y * dt;
+        }
+    });
+}
+
+static void HealthSystem(ecs::World& world, float dt, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<Health>(begin, end, [=](std::span<Health> healths)
+    {
+        for (auto& health : healths)
+        {
+            health.value = std::min(health.value + health.regeneration * dt, 100.0f);
+        }
+    });
+}
+
+static void AiSystem(ecs::World& world, float dt, std::size_t begin = 0, std::size_t end = allChunks)
+{
+    world.ForEachChunk<AiState, const Position>(begin, end,
+                                                [=](std::span<AiState> states, std::span<const Position> positions)
+    {
+        for (std::size_t i = 0; i < states.size(); i++)
+        {
+            states[i].timer += dt;
+            //Branchless state pick: chase when inside the arena, wander otherwise
+            states[i].state = (positions[i].x * positions[i].x + positions[i].y * positions[i].y) < 250000.0f;
+        }
+    });
+}
+
+//The three TransformSystem updates as queries over every archetype, compare with BM_SOA
+static void BM_EcsTransformQuery(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    for (auto _ : allocations.Loop())
+    {
+        TranslateSystem(world, 22.0f, -4.0f);
+        ScaleSystem(world, 3.0f);
+        RotateSystem(world, 45.0f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.counters["archetypes"] = static_cast<double>(world.ArchetypeCount());
+}
+
+BENCH_SWEEP(BM_EcsTransformQuery)->Arg(1 << 20);
+
+//Every system of a frame, each one only visits the archetypes holding its components
+static void BM_EcsFrame(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    constexpr float dt = 1.0f / 60.0f;
+    for (auto _ : allocations.Loop())
+    {
+        MoveSystem(world, dt);
+        HealthSystem(world, dt);
+        AiSystem(world, dt);
+        TranslateSystem(world, 22.0f, -4.0f);
+        ScaleSystem(world, 3.0f);
+        RotateSystem(world, 45.0f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsFrame)->Arg(1 << 20);
+
+//The systems of BM_EcsFrame with their component accesses. The graph orders Move -> Ai -> Translate
+//(Position written, read, then written again), Health, Scale and Rotate are independent.
+static void BuildFrameGraph(TaskGraph& graph, ecs::World& world)
+{
+    using ecs::ComponentId;
+    constexpr float dt = 1.0f / 60.0f;
+    constexpr std::size_t grain = 8;
+    graph.AddSystem("Move", {ComponentId<Velocity>()}, {ComponentId<Position>()},
+                    world.ChunkCount<Position, const Velocity>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { MoveSystem(world, dt, begin, end); });
+    graph.AddSystem("Health", {}, {ComponentId<Health>()}, world.ChunkCount<Health>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { HealthSystem(world, dt, begin, end); });
+    graph.AddSystem("Ai", {ComponentId<Position>()}, {ComponentId<AiState>()},
+                    world.ChunkCount<AiState, const Position>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { AiSystem(world, dt, begin, end); });
+    graph.AddSystem("Translate", {}, {ComponentId<Position>()}, world.ChunkCount<Position>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { TranslateSystem(world, 22.0f, -4.0f, begin, end); });
+    graph.AddSystem("Scale", {}, {ComponentId<Scale>()}, world.ChunkCount<Scale>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { ScaleSystem(world, 3.0f, begin, end); });
+    graph.AddSystem("Rotate", {}, {ComponentId<Rotation>()}, world.ChunkCount<Rotation>(), grain,
+                    [&world](std::size_t begin, std::size_t end) { RotateSystem(world, 45.0f, begin, end); });
+}
+
+//Pool sizes from 1 to the hardware concurrency, the calling thread is one of the workers
+static void WorkerArguments(benchmark::internal::Benchmark* b)
+{
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int workers = 1; workers < hardwareThreads; workers *= 2)
+    {
+        b->Args({1 << 20, workers});
+    }
+    b->Args({1 << 20, hardwareThreads});
+}
+
+static void BM_EcsFrameTaskGraph(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    TaskGraph graph;
+    BuildFrameGraph(graph, world);
+    WorkStealingPool pool(state.range(1));
+    for (auto _ : allocations.Loop())
+    {
+        graph.Run(pool);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.counters["edges"] = static_cast<double>(graph.EdgeCount());
+    state.counters["steals"] = benchmark::Counter(static_cast<double>(pool.Steals()), benchmark::Counter::kAvgIterations);
+}
+
+BENCH_SWEEP(BM_EcsFrameTaskGraph)->Apply(WorkerArguments)->ArgNames({"entities", "workers"})->UseRealTime();
+
+//Same graph run in declaration order on one thread, the baseline of BM_EcsFrameTaskGraph
+static void BM_EcsFrameSerial(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    TaskGraph graph;
+    BuildFrameGraph(graph, world);
+    for (auto _ : allocations.Loop())
+    {
+        graph.RunSerial();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsFrameSerial)->Arg(1 << 20)->ArgName("entities")->UseRealTime();
+
+//Same work as MoveSystem through the per-entity callback instead of the chunk spans
+static void BM_EcsForEachEntity(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    constexpr float dt = 1.0f / 60.0f;
+    for (auto _ : allocations.Loop())
+    {
+        world.ForEach<Position, const Velocity>([=](Position& position, const Velocity& velocity)
+        {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+        });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsForEachEntity)->Arg(1 << 20);
+
+static void BM_EcsForEachChunk(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    PopulateWorld(world, count);
+    for (auto _ : allocations.Loop())
+    {
+        MoveSystem(world, 1.0f / 60.0f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsForEachChunk)->Arg(1 << 20);
+
+//Adds then removes a component on every entity, each change moves the entity to another archetype.
+//The removal pass walks the entities in reverse so rows are taken from the end of the source chunks.
+static void BM_EcsAddRemoveComponent(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    ecs::World world;
+    const auto entities = PopulateWorld(world, count);
+    for (auto _ : allocations.Loop())
+    {
+        for (const auto entity : entities)
+        {
+            world.Add(entity, Stunned{1.0f});
+        }
+        for (auto it = entities.rbegin(); it != entities.rend(); ++it)
+        {
+            world.Remove<Stunned>(*it);
+        }
+    }
+    state.SetItemsProcessed(2 * static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsAddRemoveComponent)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+//Entity creation into 8 archetypes and destruction, including the chunk allocations
+static void BM_EcsCreateDestroy(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = state.range(0);
+    for (auto _ : allocations.Loop())
+    {
+        ecs::World world;
+        const auto entities = PopulateWorld(world, count);
+        for (const auto entity : entities)
+        {
+            world.Destroy(entity);
+        }
+        benchmark::DoNotOptimize(world.EntityCount());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+}
+
+BENCH_SWEEP(BM_EcsCreateDestroy)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+BENCH_HARNESS_MAIN();
@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <atomic>
+#include <thread>
+#include "cache_topology.h"
+#include "perf_counters.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Fixed rather than std::hardware_destructive_interference_size, whose value depends on the -mtune of the build.
+//Two 64 byte lines, the adjacent line prefetcher pulls lines in pairs, the runtime line size is reported.
+constexpr std::size_t cacheLinePadding = 128;
+
+constexpr int maxThreads = 256;
+constexpr long opsPerIteration = 1024;
+
+//Each thread owns one slot, but neighbouring slots share a cache line
+static std::array<std::atomic<long>, maxThreads> packedCounters{};
+
+struct alignas(cacheLinePadding) PaddedCounter
+{
+    std::atomic<long> value{0};
+};
+static std::array<PaddedCounter, maxThreads> paddedCounters{};
+
+alignas(cacheLinePadding) static std::atomic<long> sharedCounter{0};
+
+//Relaxed load + store is a plain mov: the cost measured is the line ping-pong, not the lock prefix
+static void Increment(std::atomic<long>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+//L1D read misses per op, on a working set that fits in L1 these are coherence misses
+class CoherenceMissCounter
+{
+public:
+    CoherenceMissCounter() : m_Counter(PerfEvent::L1DReadMiss) { m_Counter.Start(); }
+    void Report(benchmark::State& state)
+    {
+        m_Counter.Stop();
+        if (!m_Counter.IsValid())
+        {
+            return;
+        }
+        const double ops = static_cast<double>(state.iterations() * opsPerIteration);
+        state.counters["l1d_miss_per_op"] =
+            benchmark::Counter(static_cast<double>(m_Counter.Read()) / ops, benchmark::Counter::kAvgThreads);
+    }
+private:
+    PerfCounter m_Counter;
+};
+
+static void ReportOps(benchmark::State& state)
+{
+    state.counters["ops"] = benchmark::Counter(static_cast<double>(state.iterations() * opsPerIteration),
+                                               benchmark::Counter::kIsRate);
+}
+
+static void BM_PackedCounters(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    auto& counter = packedCounters[state.thread_index()];
+    CoherenceMissCounter misses;
+    for (auto _ : allocations.Loop())
+    {
+        for (long i = 0; i < opsPerIteration; i++)
+        {
+            Increment(counter);
+        }
+    }
+    misses.Report(state);
+    ReportOps(state);
+}
+
+static void BM_PaddedCounters(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    auto& counter = paddedCounters[state.thread_index()].value;
+    CoherenceMissCounter misses;
+    for (auto _ : allocations.Loop())
+    {
+        for (long i = 0; i < opsPerIteration; i++)
+        {
+            Increment(counter);
+        }
+    }
+    misses.Report(state);
+    ReportOps(state);
+    state.counters["line_bytes"] = static_cast<double>(GetCacheTopology().LineSize());
+    state.counters["padding_bytes"] = static_cast<double>(cacheLinePadding);
+}
+
+//Counts in a register and publishes once per thread at the end
+static void BM_ShardedCounters(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    if (state.thread_index() == 0)
+    {
+        sharedCounter.store(0);
+    }
+    CoherenceMissCounter misses;
+    long local = 0;
+    for (auto _ : allocations.Loop())
+    {
+        for (long i = 0; i < opsPerIteration; i++)
+        {
+            local++;
+            benchmark::DoNotOptimize(local);
+        }
+    }
+    sharedCounter.fetch_add(local, std::memory_order_relaxed);
+    misses.Report(state);
+    ReportOps(state);
+}
+
+template<std::memory_order Order>
+static void BM_AtomicFetchAdd(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    CoherenceMissCounter misses;
+    for (auto _ : allocations.Loop())
+    {
+        for (long i = 0; i < opsPerIteration; i++)
+        {
+            sharedCounter.fetch_add(1, Order);
+        }
+    }
+    misses.Report(state);
+    ReportOps(state);
+}
+
+//1, 2, 4... up to the number of hardware threads, which is always included
+static void ThreadSweep(benchmark::internal::Benchmark* b)
+{
+    const int hardwareThreads =
+        std::min(maxThreads, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    for (int threads = 1; threads < hardwareThreads; threads *= 2)
+    {
+        b->Threads(threads);
+    }
+    b->Threads(hardwareThreads);
+}
+
+BENCH_SWEEP(BM_PackedCounters)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP(BM_PaddedCounters)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP(BM_ShardedCounters)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_AtomicFetchAdd, std::memory_order_relaxed)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_AtomicFetchAdd, std::memory_order_acq_rel)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_AtomicFetchAdd, std::memory_order_seq_cst)->ApplyThreads(ThreadSweep)->UseRealTime();
+
+BENCH_HARNESS_MAIN();
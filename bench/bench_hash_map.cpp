@@ -0,0 +1,159 @@
+#include <benchmark/benchmark.h>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cache_topology.h"
+#include "flat_hash_map.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
+
+//BM_RandomCacheBench for the hot path it stands in for: random lookups of present keys in a hash table whose
+//footprint grows from the L1 to 8x the LLC. std::unordered_map holds the same entries, its nodes and bucket
+//array make it larger.
+using FlatLookupMap = FlatHashMap<std::uint64_t, std::uint64_t>;
+
+constexpr std::size_t hashLookups = 1 << 16;
+
+//Entries that fill a flat table of about 2^range(0) bytes to 3/4, under its 7/8 maximum load
+static std::size_t HashEntries(const benchmark::State& state)
+{
+    const std::size_t bytes = std::size_t{1} << state.range(0);
+    const std::size_t capacity = std::bit_floor(bytes / (2 * sizeof(std::uint64_t) + 1));
+    return capacity / 4 * 3;
+}
+
+static std::span<const std::uint64_t> HashKeys(std::size_t entries)
+{
+    return CachedDataset<std::uint64_t>("hash_keys", entries, 1, [](std::span<std::uint64_t> keys, std::mt19937_64& gen)
+    {
+        for (auto& key : keys)
+        {
+            key = gen();
+        }
+    });
+}
+
+//Present keys in random order
+static std::span<const std::uint64_t> HashLookups(std::size_t entries)
+{
+    return CachedDataset<std::uint64_t>("hash_lookups_" + std::to_string(entries), hashLookups, 1,
+                                        [entries](std::span<std::uint64_t> lookups, std::mt19937_64& gen)
+    {
+        const auto keys = HashKeys(entries);
+        std::uniform_int_distribution<std::size_t> dis(0, entries - 1);
+        for (auto& lookup : lookups)
+        {
+            lookup = keys[dis(gen)];
+        }
+    });
+}
+
+static void ReportLookups(benchmark::State& state, std::size_t tableBytes)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(hashLookups) * state.iterations());
+    state.counters["lookups_per_second"] =
+        benchmark::Counter(static_cast<double>(hashLookups), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["table_bytes"] = static_cast<double>(tableBytes);
+    state.SetLabel(cache_topology_detail::FormatBytes(tableBytes));
+}
+
+static void BM_HashUnorderedMap(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t entries = HashEntries(state);
+    const auto keys = HashKeys(entries);
+    const auto lookups = HashLookups(entries);
+    std::unordered_map<std::uint64_t, std::uint64_t> map;
+    map.reserve(entries);
+    for (std::size_t i = 0; i < entries; i++)
+    {
+        map.emplace(keys[i], i);
+    }
+    for (auto _ : allocations.Loop())
+    {
+        std::uint64_t sum = 0;
+        for (const auto key : lookups)
+        {
+            sum += map.find(key)->second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    //One node per entry (next pointer, key, value) and one pointer per bucket
+    ReportLookups(state, entries * 3 * sizeof(void*) + map.bucket_count() * sizeof(void*));
+}
+
+static void BM_HashFlatMap(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t entries = HashEntries(state);
+    const auto keys = HashKeys(entries);
+    const auto lookups = HashLookups(entries);
+    FlatLookupMap map(entries);
+    for (std::size_t i = 0; i < entries; i++)
+    {
+        map.Insert(keys[i], i);
+    }
+    for (auto _ : allocations.Loop())
+    {
+        std::uint64_t sum = 0;
+        for (const auto key : lookups)
+        {
+            sum += *map.Find(key);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    ReportLookups(state, map.MemoryBytes());
+}
+
+static void BM_HashFlatMapBatched(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t entries = HashEntries(state);
+    const auto keys = HashKeys(entries);
+    const auto lookups = HashLookups(entries);
+    FlatLookupMap map(entries);
+    for (std::size_t i = 0; i < entries; i++)
+    {
+        map.Insert(keys[i], i);
+    }
+    std::vector<const std::uint64_t*> results(FlatLookupMap::batchSize);
+    for (auto _ : allocations.Loop())
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t begin = 0; begin < lookups.size(); begin += results.size())
+        {
+            map.FindBatch(lookups.subspan(begin, results.size()), results);
+            for (const auto* value : results)
+            {
+                sum += *value;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    ReportLookups(state, map.MemoryBytes());
+}
+
+//Flat table footprints from the L1 size to at least 8x the LLC, every factor of 4
+static void HashTableSizes(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    const int from = Log2Floor(topology.L1().size);
+    const int to = Log2Ceil(8 * topology.LLC().size) + 1;
+    for (int size = from; size < to; size += 2)
+    {
+        b->Arg(size);
+    }
+    b->Arg(to);
+}
+
+BENCH_SWEEP(BM_HashUnorderedMap)->Apply(HashTableSizes)->ArgName("log2_bytes");
+BENCH_SWEEP(BM_HashFlatMap)->Apply(HashTableSizes)->ArgName("log2_bytes");
+BENCH_SWEEP(BM_HashFlatMapBatched)->Apply(HashTableSizes)->ArgName("log2_bytes");
+
+BENCH_HARNESS_MAIN();
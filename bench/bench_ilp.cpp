@@ -0,0 +1,252 @@
+#include <benchmark/benchmark.h>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "cycle_clock.h"
+#include "perf_counters.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+constexpr int chainLength = 1024;
+constexpr int maxAccumulators = 16;
+
+//Forces the value into a register after every op, so the compiler can neither
+//reassociate the chains (-ffast-math) nor merge accumulators into vectors
+template<typename T>
+inline void Pin(T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        asm volatile("" : "+x"(value));
+    }
+    else
+    {
+        asm volatile("" : "+r"(value));
+    }
+#else
+    benchmark::DoNotOptimize(value);
+#endif
+}
+
+struct OpAdd
+{
+    using Type = std::uint64_t;
+    static constexpr const char* name = "add";
+    static Type Init(int i) { return static_cast<Type>(i); }
+    static Type Operand() { return 3; }
+    static Type Apply(Type acc, Type x) { return acc + x; }
+};
+
+struct OpMul
+{
+    using Type = std::uint64_t;
+    static constexpr const char* name = "mul";
+    static Type Init(int i) { return static_cast<Type>(2 * i + 1); }
+    static Type Operand() { return 0x9E3779B97F4A7C15ull; }
+    static Type Apply(Type acc, Type x) { return acc * x; }
+};
+
+struct OpDiv
+{
+    using Type = double;
+    static constexpr const char* name = "div";
+    static Type Init(int i) { return 1.0 + i; }
+    //Close to one so the chain never reaches denormals
+    static Type Operand() { return 1.0000001; }
+    static Type Apply(Type acc, Type x)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        //-ffast-math would otherwise turn the loop-invariant divide into a multiply by its reciprocal
+        asm("divsd {%1, %0|%0, %1}" : "+x"(acc) : "x"(x));
+        return acc;
+#else
+        return acc / x;
+#endif
+    }
+};
+
+struct OpFma
+{
+    using Type = double;
+    static constexpr const char* name = "fma";
+    static Type Init(int i) { return 1.0 + i; }
+    static Type Operand() { return 0.999999; }
+    static Type Apply(Type acc, Type x) { return std::fma(acc, x, 1e-9); }
+};
+
+struct OpSqrt
+{
+    using Type = double;
+    static constexpr const char* name = "sqrt";
+    static Type Init(int i) { return 2.0 + i; }
+    static Type Operand() { return 0.0; }
+    static Type Apply(Type acc, Type) { return std::sqrt(acc); }
+};
+
+struct OpPopcnt
+{
+    using Type = std::uint64_t;
+    static constexpr const char* name = "popcnt";
+    static Type Init(int i) { return 0xFFFFull << i; }
+    static Type Operand() { return 0x00FF00FF00FF00FFull; }
+    //popcnt alone on the chain, its latency does not depend on the value so the count feeding itself is fine
+    static Type Apply(Type acc, Type) { return static_cast<Type>(std::popcount(acc)); }
+};
+
+//With one accumulator every op waits for the previous one (latency), with enough
+//independent accumulators the core issues them back to back (throughput)
+template<typename Op, int Accumulators>
+static void BM_Ilp(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    using T = typename Op::Type;
+    T acc[Accumulators];
+    for (int i = 0; i < Accumulators; i++)
+    {
+        acc[i] = Op::Init(i);
+    }
+    T x = Op::Operand();
+    Pin(x);
+    //Core cycles follow the clock the ops actually run at, TSC reference cycles only when perf is unavailable
+    PerfCounter coreCycles(PerfEvent::Cycles);
+    const bool referenceCycles = !coreCycles.IsValid();
+    std::uint64_t cycles = 0;
+    coreCycles.Start();
+    for (auto _ : allocations.Loop())
+    {
+        const std::uint64_t start = referenceCycles ? ReadCycles() : 0;
+        for (int i = 0; i < chainLength; i++)
+        {
+            [&]<std::size_t... J>(std::index_sequence<J...>)
+            {
+                ((acc[J] = Op::Apply(acc[J], x), Pin(acc[J])), ...);
+            }(std::make_index_sequence<Accumulators>{});
+        }
+        if (referenceCycles)
+        {
+            cycles += ReadCycles() - start;
+        }
+    }
+    coreCycles.Stop();
+    if (!referenceCycles)
+    {
+        cycles = coreCycles.Read();
+    }
+    for (int i = 0; i < Accumulators; i++)
+    {
+        benchmark::DoNotOptimize(acc[i]);
+    }
+    const double ops = static_cast<double>(state.iterations()) * chainLength * Accumulators;
+    state.counters["accumulators"] = Accumulators;
+    state.counters["cycles_per_op"] = static_cast<double>(cycles) / ops;
+    state.counters["reference_cycles"] = referenceCycles ? 1 : 0;
+    state.counters["ops"] = benchmark::Counter(ops, benchmark::Counter::kIsRate);
+    state.SetLabel(Op::name);
+}
+
+template<typename Op, std::size_t... N>
+static void RegisterIlp(std::index_sequence<N...>)
+{
+    ((benchmark::RegisterBenchmark((std::string("BM_Ilp<") + Op::name + ">/acc:" + std::to_string(N + 1)).c_str(),
+                                   BM_Ilp<Op, static_cast<int>(N) + 1>)), ...);
+}
+
+template<typename... Ops>
+static bool RegisterIlpSuite()
+{
+    (RegisterIlp<Ops>(std::make_index_sequence<maxAccumulators>{}), ...);
+    return true;
+}
+
+static const bool ilpRegistered = RegisterIlpSuite<OpAdd, OpMul, OpDiv, OpFma, OpSqrt, OpPopcnt>();
+
+//Summarizes the runs as one latency/throughput row per op
+class IlpTableReporter : public benchmark::ConsoleReporter
+{
+public:
+    void ReportRuns(const std::vector<Run>& reports) override
+    {
+        ConsoleReporter::ReportRuns(reports);
+        for (const auto& run : reports)
+        {
+            if (run.error_occurred || run.run_type != Run::RT_Iteration)
+            {
+                continue;
+            }
+            const auto accumulators = run.counters.find("accumulators");
+            const auto cycles = run.counters.find("cycles_per_op");
+            if (accumulators == run.counters.end() || cycles == run.counters.end())
+            {
+                continue;
+            }
+            m_Cycles[run.report_label][static_cast<int>(accumulators->second.value)] = cycles->second.value;
+            const auto reference = run.counters.find("reference_cycles");
+            m_ReferenceCycles |= reference != run.counters.end() && reference->second.value != 0;
+        }
+    }
+
+    //Unroll is the smallest accumulator count within 5% of the best throughput
+    void PrintTable(std::ostream& os) const
+    {
+        os << "\n" << std::left << std::setw(8) << "op" << std::right << std::setw(16) << "latency (cyc)"
+           << std::setw(20) << "throughput (cyc/op)" << std::setw(10) << "unroll" << "\n";
+        for (const auto& [op, byAccumulators] : m_Cycles)
+        {
+            double best = std::numeric_limits<double>::max();
+            for (const auto& [accumulators, cycles] : byAccumulators)
+            {
+                best = std::min(best, cycles);
+            }
+            int unroll = 0;
+            for (const auto& [accumulators, cycles] : byAccumulators)
+            {
+                if (cycles <= best * 1.05)
+                {
+                    unroll = accumulators;
+                    break;
+                }
+            }
+            const auto latency = byAccumulators.find(1);
+            os << std::left << std::setw(8) << op << std::right << std::fixed << std::setprecision(2) << std::setw(16)
+               << (latency != byAccumulators.end() ? latency->second : 0.0) << std::setw(20) << best
+               << std::setw(10) << unroll << "\n";
+        }
+        os << (m_ReferenceCycles ? "cycles are TSC reference cycles (rdtscp), perf core cycles are unavailable\n"
+                                 : "cycles are core cycles (perf)\n");
+        os.unsetf(std::ios::floatfield);
+    }
+
+private:
+    std::map<std::string, std::map<int, double>> m_Cycles;
+    bool m_ReferenceCycles = false;
+};
+
+#ifndef BENCH_DRIVER
+int main(int argc, char** argv)
+{
+    const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv);
+    if (!ConfigureSweeps(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    IlpTableReporter reporter;
+    RunHarnessedBenchmarks(harnessOptions, &reporter);
+    reporter.PrintTable(std::cout);
+    benchmark::Shutdown();
+    return 0;
+}
+#endif
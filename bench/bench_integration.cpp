@@ -0,0 +1,401 @@
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+#include "intrinsics.h"
+#include "vec2.h"
+#include "vectorize_guard.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Per-entity motion integration with damping, the per-frame workload the transform systems stand in for.
+//Verlet is the velocity form, it keeps the same state as Euler:
+//  SemiImplicitEuler  v = (v + a dt) damping, x += v dt
+//  Verlet             x += (v + a dt / 2) dt,  v = (v + a dt) damping
+enum class Integrator
+{
+    SemiImplicitEuler,
+    Verlet,
+};
+
+constexpr float frameDt = 1.0f / 60.0f;
+constexpr float damping = 0.99f;
+//Position and velocity are read and written, acceleration is only read
+constexpr int64_t bytesPerEntity = 6 * sizeof(float) + 4 * sizeof(float);
+
+struct BodySample
+{
+    float positionX;
+    float positionY;
+    float velocityX;
+    float velocityY;
+    float accelerationX;
+    float accelerationY;
+};
+
+static std::span<const BodySample> BodyDataset(std::size_t count)
+{
+    return CachedDataset<BodySample>("integration_bodies", count, 1, [](std::span<BodySample> samples, std::mt19937_64& gen)
+    {
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> velocity(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> acceleration(-1.0f, 1.0f);
+        for (auto& sample : samples)
+        {
+            sample = {position(gen), position(gen), velocity(gen), velocity(gen), acceleration(gen), acceleration(gen)};
+        }
+    });
+}
+
+//AOSOA blocks need whole lanes
+static std::size_t EntityCount(const benchmark::State& state)
+{
+    return (static_cast<std::size_t>(state.range(0)) + 7) / 8 * 8;
+}
+
+template<Integrator I>
+inline void IntegrateScalar(float& px, float& py, float& vx, float& vy, float ax, float ay, float dt)
+{
+    if constexpr (I == Integrator::SemiImplicitEuler)
+    {
+        vx = (vx + ax * dt) * damping;
+        vy = (vy + ay * dt) * damping;
+        px += vx * dt;
+        py += vy * dt;
+    }
+    else
+    {
+        const float halfDt = 0.5f * dt;
+        px += (vx + ax * halfDt) * dt;
+        py += (vy + ay * halfDt) * dt;
+        vx = (vx + ax * dt) * damping;
+        vy = (vy + ay * dt) * damping;
+    }
+}
+
+//Plain loop over separate float arrays, left to the auto-vectorizer
+template<Integrator I>
+inline void IntegrateArrays(float* __restrict px, float* __restrict py, float* __restrict vx, float* __restrict vy,
+                            const float* __restrict ax, const float* __restrict ay, std::size_t count, float dt)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        IntegrateScalar<I>(px[i], py[i], vx[i], vy[i], ax[i], ay[i], dt);
+    }
+}
+
+#ifdef __SSE__
+struct Sse
+{
+    using Vec = __m128;
+    static constexpr std::size_t width = 4;
+    static Vec Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+    static Vec Set1(float x) { return _mm_set1_ps(x); }
+    static Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    static Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    //a * b + c
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+};
+#endif
+
+#ifdef __AVX__
+struct Avx
+{
+    using Vec = __m256;
+    static constexpr std::size_t width = 8;
+    static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    static Vec Set1(float x) { return _mm256_set1_ps(x); }
+    static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+#ifdef __FMA__
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+};
+#endif
+
+//count must be a multiple of Simd::width
+template<typename Simd, Integrator I>
+inline void IntegrateSimd(float* px, float* py, float* vx, float* vy, const float* ax, const float* ay,
+                          std::size_t count, float dt)
+{
+    const auto dtv = Simd::Set1(dt);
+    const auto halfDt = Simd::Set1(0.5f * dt);
+    const auto dampingv = Simd::Set1(damping);
+    for (std::size_t i = 0; i < count; i += Simd::width)
+    {
+        auto x = Simd::Load(px + i);
+        auto y = Simd::Load(py + i);
+        auto velX = Simd::Load(vx + i);
+        auto velY = Simd::Load(vy + i);
+        const auto accX = Simd::Load(ax + i);
+        const auto accY = Simd::Load(ay + i);
+        if constexpr (I == Integrator::Verlet)
+        {
+            x = Simd::MulAdd(Simd::MulAdd(accX, halfDt, velX), dtv, x);
+            y = Simd::MulAdd(Simd::MulAdd(accY, halfDt, velY), dtv, y);
+        }
+        velX = Simd::Mul(Simd::MulAdd(accX, dtv, velX), dampingv);
+        velY = Simd::Mul(Simd::MulAdd(accY, dtv, velY), dampingv);
+        if constexpr (I == Integrator::SemiImplicitEuler)
+        {
+            x = Simd::MulAdd(velX, dtv, x);
+            y = Simd::MulAdd(velY, dtv, y);
+        }
+        Simd::Store(px + i, x);
+        Simd::Store(py + i, y);
+        Simd::Store(vx + i, velX);
+        Simd::Store(vy + i, velY);
+    }
+}
+
+namespace AOS
+{
+struct Body
+{
+    sfge::Vec2f position;
+    sfge::Vec2f velocity;
+    sfge::Vec2f acceleration;
+};
+
+template<Integrator I>
+class IntegrationSystem
+{
+public:
+    explicit IntegrationSystem(std::size_t count)
+    {
+        for (const auto& sample : BodyDataset(count))
+        {
+            m_Bodies.push_back({{sample.positionX, sample.positionY}, {sample.velocityX, sample.velocityY},
+                                {sample.accelerationX, sample.accelerationY}});
+        }
+    }
+    void Integrate(float dt)
+    {
+        for (auto& body : m_Bodies)
+        {
+            IntegrateScalar<I>(body.position.x, body.position.y, body.velocity.x, body.velocity.y,
+                               body.acceleration.x, body.acceleration.y, dt);
+        }
+    }
+private:
+    std::vector<Body> m_Bodies;
+};
+}
+
+namespace SOA
+{
+template<Integrator I>
+class IntegrationSystem
+{
+public:
+    explicit IntegrationSystem(std::size_t count)
+    {
+        for (const auto& sample : BodyDataset(count))
+        {
+            m_PositionsX.push_back(sample.positionX);
+            m_PositionsY.push_back(sample.positionY);
+            m_VelocitiesX.push_back(sample.velocityX);
+            m_VelocitiesY.push_back(sample.velocityY);
+            m_AccelerationsX.push_back(sample.accelerationX);
+            m_AccelerationsY.push_back(sample.accelerationY);
+        }
+    }
+    void Integrate(float dt)
+    {
+        VECTORIZE_GUARD_BEGIN("SOA::IntegrationSystem::Integrate", "avx");
+        IntegrateArrays<I>(m_PositionsX.data(), m_PositionsY.data(), m_VelocitiesX.data(), m_VelocitiesY.data(),
+                           m_AccelerationsX.data(), m_AccelerationsY.data(), m_PositionsX.size(), dt);
+        VECTORIZE_GUARD_END("SOA::IntegrationSystem::Integrate");
+    }
+#ifdef __AVX__
+    void IntegrateIntrinsics(float dt)
+    {
+        IntegrateSimd<Avx, I>(m_PositionsX.data(), m_PositionsY.data(), m_VelocitiesX.data(), m_VelocitiesY.data(),
+                              m_AccelerationsX.data(), m_AccelerationsY.data(), m_PositionsX.size(), dt);
+    }
+#endif
+private:
+    std::vector<float> m_PositionsX;
+    std::vector<float> m_PositionsY;
+    std::vector<float> m_VelocitiesX;
+    std::vector<float> m_VelocitiesY;
+    std::vector<float> m_AccelerationsX;
+    std::vector<float> m_AccelerationsY;
+};
+}
+
+namespace AOSOA
+{
+//NPos-style lanes of one 2D quantity for N entities
+template<size_t N>
+struct alignas(N * sizeof(float)) NVec2
+{
+    std::array<float, N> x;
+    std::array<float, N> y;
+};
+
+//Velocity and acceleration lanes next to the position lanes of the same N entities
+template<size_t N>
+struct NBody
+{
+    NVec2<N> position;
+    NVec2<N> velocity;
+    NVec2<N> acceleration;
+};
+
+template<size_t N, Integrator I>
+class IntegrationSystem
+{
+public:
+    explicit IntegrationSystem(std::size_t count)
+    {
+        const auto samples = BodyDataset(count);
+        m_Bodies.resize(count / N);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto& body = m_Bodies[i / N];
+            const auto& sample = samples[i];
+            body.position.x[i % N] = sample.positionX;
+            body.position.y[i % N] = sample.positionY;
+            body.velocity.x[i % N] = sample.velocityX;
+            body.velocity.y[i % N] = sample.velocityY;
+            body.acceleration.x[i % N] = sample.accelerationX;
+            body.acceleration.y[i % N] = sample.accelerationY;
+        }
+    }
+    void Integrate(float dt)
+    {
+        for (auto& body : m_Bodies)
+        {
+            IntegrateArrays<I>(body.position.x.data(), body.position.y.data(), body.velocity.x.data(),
+                               body.velocity.y.data(), body.acceleration.x.data(), body.acceleration.y.data(), N, dt);
+        }
+    }
+    //SSE for 4 lanes, AVX (with FMA when available) for 8
+    void IntegrateIntrinsics(float dt)
+    {
+#ifdef __AVX__
+        using Simd = std::conditional_t<N % 8 == 0, Avx, Sse>;
+#else
+        using Simd = Sse;
+#endif
+        for (auto& body : m_Bodies)
+        {
+            IntegrateSimd<Simd, I>(body.position.x.data(), body.position.y.data(), body.velocity.x.data(),
+                                   body.velocity.y.data(), body.acceleration.x.data(), body.acceleration.y.data(), N,
+                                   dt);
+        }
+    }
+private:
+    std::vector<NBody<N>> m_Bodies;
+};
+}
+
+static void ReportThroughput(benchmark::State& state, std::size_t count)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(count) * state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(count) * bytesPerEntity * state.iterations());
+}
+
+template<Integrator I>
+static void BM_IntegrateAOS(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = EntityCount(state);
+    AOS::IntegrationSystem<I> system(count);
+    for (auto _ : allocations.Loop())
+    {
+        system.Integrate(frameDt);
+        benchmark::ClobberMemory();
+    }
+    ReportThroughput(state, count);
+}
+
+template<Integrator I>
+static void BM_IntegrateSOA(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = EntityCount(state);
+    SOA::IntegrationSystem<I> system(count);
+    for (auto _ : allocations.Loop())
+    {
+        system.Integrate(frameDt);
+        benchmark::ClobberMemory();
+    }
+    ReportThroughput(state, count);
+}
+
+template<size_t N, Integrator I>
+static void BM_IntegrateAOSOA(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = EntityCount(state);
+    AOSOA::IntegrationSystem<N, I> system(count);
+    for (auto _ : allocations.Loop())
+    {
+        system.Integrate(frameDt);
+        benchmark::ClobberMemory();
+    }
+    ReportThroughput(state, count);
+}
+
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOS, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOS, Integrator::Verlet)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateSOA, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateSOA, Integrator::Verlet)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOA, 4, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOA, 4, Integrator::Verlet)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOA, 8, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOA, 8, Integrator::Verlet)->Arg(1 << 20);
+
+#ifdef __AVX__
+template<Integrator I>
+static void BM_IntegrateSOAIntrinsics(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = EntityCount(state);
+    SOA::IntegrationSystem<I> system(count);
+    for (auto _ : allocations.Loop())
+    {
+        system.IntegrateIntrinsics(frameDt);
+        benchmark::ClobberMemory();
+    }
+    ReportThroughput(state, count);
+}
+
+BENCH_SWEEP_TEMPLATE(BM_IntegrateSOAIntrinsics, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateSOAIntrinsics, Integrator::Verlet)->Arg(1 << 20);
+#endif
+
+#ifdef __SSE__
+template<size_t N, Integrator I>
+static void BM_IntegrateAOSOAIntrinsics(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t count = EntityCount(state);
+    AOSOA::IntegrationSystem<N, I> system(count);
+    for (auto _ : allocations.Loop())
+    {
+        system.IntegrateIntrinsics(frameDt);
+        benchmark::ClobberMemory();
+    }
+    ReportThroughput(state, count);
+}
+
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOAIntrinsics, 4, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOAIntrinsics, 4, Integrator::Verlet)->Arg(1 << 20);
+#ifdef __AVX__
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOAIntrinsics, 8, Integrator::SemiImplicitEuler)->Arg(1 << 20);
+BENCH_SWEEP_TEMPLATE(BM_IntegrateAOSOAIntrinsics, 8, Integrator::Verlet)->Arg(1 << 20);
+#endif
+#endif
+
+BENCH_HARNESS_MAIN();
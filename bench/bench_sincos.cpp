@@ -0,0 +1,178 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include "aosoa.h"
+#include "sincos.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Rotated basis vectors of every entity from the AOSOA Euler angles (degrees), SinCosDegrees against libm.
+//Each run also reports the error of its last frame against a double precision reference.
+constexpr double pi = 3.14159265358979323846;
+
+static std::span<const float> SinCosAngles(std::size_t count, long range)
+{
+    return CachedDataset<float>("sincos_angles_" + std::to_string(range), count, 1,
+                                [range](std::span<float> angles, std::mt19937_64& gen)
+    {
+        std::uniform_real_distribution<float> dis(-static_cast<float>(range), static_cast<float>(range));
+        for (auto& angle : angles)
+        {
+            angle = dis(gen);
+        }
+    });
+}
+
+template<size_t N>
+static std::vector<AOSOA::NAngle<N>> SinCosBlocks(std::span<const float> angles)
+{
+    std::vector<AOSOA::NAngle<N>> blocks(angles.size() / N);
+    for (std::size_t i = 0; i < blocks.size() * N; i++)
+    {
+        blocks[i / N].eulerAngles[i % N] = angles[i];
+    }
+    return blocks;
+}
+
+//Distance in representable floats, 0 and -0 are the same
+static std::int64_t UlpDistance(float a, float b)
+{
+    const auto ordered = [](float x)
+    {
+        const auto bits = std::bit_cast<std::int32_t>(x);
+        return bits < 0 ? -static_cast<std::int64_t>(bits & 0x7FFFFFFF) : static_cast<std::int64_t>(bits);
+    };
+    return std::abs(ordered(a) - ordered(b));
+}
+
+//Reduced by quarter turns in double, exact so that multiples of 90 degrees give exact zeros
+static void ReferenceSinCos(float degrees, double& sine, double& cosine)
+{
+    const double quadrant = std::nearbyint(static_cast<double>(degrees) / 90.0);
+    const double radians = (static_cast<double>(degrees) - 90.0 * quadrant) * pi / 180.0;
+    const double sinR = std::sin(radians);
+    const double cosR = std::cos(radians);
+    switch (static_cast<std::int64_t>(quadrant) & 3)
+    {
+    case 0:
+        sine = sinR;
+        cosine = cosR;
+        break;
+    case 1:
+        sine = cosR;
+        cosine = -sinR;
+        break;
+    case 2:
+        sine = -sinR;
+        cosine = -cosR;
+        break;
+    default:
+        sine = -cosR;
+        cosine = sinR;
+        break;
+    }
+}
+
+template<size_t N>
+static void ReportAccuracy(benchmark::State& state, const std::vector<AOSOA::NAngle<N>>& angles,
+                           const std::vector<AOSOA::NBasis<N>>& bases)
+{
+    std::int64_t maxUlpSin = 0;
+    std::int64_t maxUlpCos = 0;
+    double maxAbsError = 0.0;
+    for (std::size_t block = 0; block < angles.size(); block++)
+    {
+        for (std::size_t lane = 0; lane < N; lane++)
+        {
+            double sine;
+            double cosine;
+            ReferenceSinCos(angles[block].eulerAngles[lane], sine, cosine);
+            const float computedSine = bases[block].xAxisY[lane];
+            const float computedCosine = bases[block].xAxisX[lane];
+            maxUlpSin = std::max(maxUlpSin, UlpDistance(computedSine, static_cast<float>(sine)));
+            maxUlpCos = std::max(maxUlpCos, UlpDistance(computedCosine, static_cast<float>(cosine)));
+            maxAbsError = std::max({maxAbsError, std::abs(computedSine - sine), std::abs(computedCosine - cosine)});
+        }
+    }
+    state.counters["max_ulp_sin"] = static_cast<double>(maxUlpSin);
+    state.counters["max_ulp_cos"] = static_cast<double>(maxUlpCos);
+    state.counters["max_abs_error"] = maxAbsError;
+}
+
+//What the transform systems would write without a vector sincos
+static void BM_SinCosLibm(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    constexpr size_t N = 8;
+    const auto angles = SinCosBlocks<N>(SinCosAngles(static_cast<std::size_t>(state.range(0)), state.range(1)));
+    std::vector<AOSOA::NBasis<N>> bases(angles.size());
+    constexpr float degToRad = static_cast<float>(pi / 180.0);
+    for (auto _ : allocations.Loop())
+    {
+        for (std::size_t block = 0; block < angles.size(); block++)
+        {
+            for (std::size_t lane = 0; lane < N; lane++)
+            {
+                const float radians = angles[block].eulerAngles[lane] * degToRad;
+                const float sine = std::sin(radians);
+                const float cosine = std::cos(radians);
+                bases[block].xAxisX[lane] = cosine;
+                bases[block].xAxisY[lane] = sine;
+                bases[block].yAxisX[lane] = -sine;
+                bases[block].yAxisY[lane] = cosine;
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(angles.size() * N) * state.iterations());
+    state.SetLabel("libm");
+    ReportAccuracy(state, angles, bases);
+}
+
+//N = 1 is the same polynomial one lane at a time
+template<size_t N, SinCosAccuracy A>
+static void BM_SinCos(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const auto angles = SinCosBlocks<N>(SinCosAngles(static_cast<std::size_t>(state.range(0)), state.range(1)));
+    std::vector<AOSOA::NBasis<N>> bases(angles.size());
+    for (auto _ : allocations.Loop())
+    {
+        for (std::size_t block = 0; block < angles.size(); block++)
+        {
+            angles[block].template BasisIntrinsics<A>(bases[block]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(angles.size() * N) * state.iterations());
+    state.SetLabel(A == SinCosAccuracy::Fast ? "fast" : "precise");
+    ReportAccuracy(state, angles, bases);
+}
+
+//A block set that stays in L2, angles within one turn and within a few thousand turns
+static void SinCosArguments(benchmark::internal::Benchmark* b)
+{
+    b->ArgsProduct({{1 << 16}, {360, 1 << 20}})->ArgNames({"angles", "range"});
+}
+
+BENCH_SWEEP(BM_SinCosLibm)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 1, SinCosAccuracy::Fast)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 1, SinCosAccuracy::Precise)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 4, SinCosAccuracy::Fast)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 4, SinCosAccuracy::Precise)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 8, SinCosAccuracy::Fast)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 8, SinCosAccuracy::Precise)->Apply(SinCosArguments);
+#ifdef __AVX512F__
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 16, SinCosAccuracy::Fast)->Apply(SinCosArguments);
+BENCH_SWEEP_TEMPLATE(BM_SinCos, 16, SinCosAccuracy::Precise)->Apply(SinCosArguments);
+#endif
+
+BENCH_HARNESS_MAIN();
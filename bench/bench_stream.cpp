@@ -0,0 +1,349 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+#include "cache_topology.h"
+#include "intrinsics.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+#ifdef __AVX2__
+
+enum class StreamOp
+{
+    Read,
+    Write,
+    Copy,
+    Scale,
+    Triad,
+};
+
+//Arrays touched and bytes counted per element, following the STREAM convention (no write-allocate)
+template<StreamOp Op>
+constexpr std::size_t streamArrays = Op == StreamOp::Triad ? 3 : (Op == StreamOp::Copy || Op == StreamOp::Scale ? 2 : 1);
+
+//One AVX register worth of floats
+struct alignas(32) Block
+{
+    float values[8];
+};
+
+template<bool NonTemporal>
+inline void Store(Block* dst, __m256 value)
+{
+    if constexpr (NonTemporal)
+    {
+        _mm256_stream_ps(dst->values, value);
+    }
+    else
+    {
+        _mm256_store_ps(dst->values, value);
+    }
+}
+
+inline __m256 Load(const Block* src)
+{
+    return _mm256_load_ps(src->values);
+}
+
+//Blocks ahead of the loads that prefetchnta fetches, 16 lines
+constexpr std::size_t ntaPrefetchBlocks = 32;
+
+//Non-temporal reads are prefetchnta ahead of normal loads, which keeps the lines out of the outer caches.
+//MOVNTDQA is not used: it is only a hint on WC memory and a plain load on the write-back heap.
+template<StreamOp Op, bool NonTemporal>
+static __m256 StreamKernel(Block* a, const Block* b, const Block* c, std::size_t count, __m256 scalar)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    for (std::size_t i = 0; i < count; i += 4)
+    {
+        if constexpr (Op == StreamOp::Read)
+        {
+            if constexpr (NonTemporal)
+            {
+                //Prefetches do not fault, the ones past the end are dropped
+                _mm_prefetch(reinterpret_cast<const char*>(a + i + ntaPrefetchBlocks), _MM_HINT_NTA);
+                _mm_prefetch(reinterpret_cast<const char*>(a + i + ntaPrefetchBlocks + 2), _MM_HINT_NTA);
+            }
+            s0 = _mm256_add_ps(s0, Load(a + i));
+            s1 = _mm256_add_ps(s1, Load(a + i + 1));
+            s2 = _mm256_add_ps(s2, Load(a + i + 2));
+            s3 = _mm256_add_ps(s3, Load(a + i + 3));
+        }
+        else
+        {
+            for (std::size_t j = i; j < i + 4; j++)
+            {
+                if constexpr (Op == StreamOp::Write)
+                {
+                    Store<NonTemporal>(a + j, scalar);
+                }
+                else if constexpr (Op == StreamOp::Copy)
+                {
+                    Store<NonTemporal>(a + j, Load(b + j));
+                }
+                else if constexpr (Op == StreamOp::Scale)
+                {
+                    Store<NonTemporal>(a + j, _mm256_mul_ps(scalar, Load(b + j)));
+                }
+                else
+                {
+                    Store<NonTemporal>(a + j, _mm256_fmadd_ps(scalar, Load(c + j), Load(b + j)));
+                }
+            }
+        }
+    }
+    if constexpr (NonTemporal && Op != StreamOp::Read)
+    {
+        _mm_sfence();
+    }
+    return _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3));
+}
+
+//L1 and L2 are private so each thread's working set is compared to them, the LLC is shared by all the threads
+static const char* CacheLevelName(std::size_t bytes, int threads)
+{
+    const auto& topology = GetCacheTopology();
+    if (bytes <= topology.L1().size)
+    {
+        return "L1";
+    }
+    if (bytes <= topology.L2().size)
+    {
+        return "L2";
+    }
+    if (bytes * static_cast<std::size_t>(threads) <= topology.LLC().size)
+    {
+        return "LLC";
+    }
+    return "DRAM";
+}
+
+//range(0) is log2 of the working set of one thread, split evenly between the arrays used
+template<StreamOp Op, bool NonTemporal>
+static void BM_Stream(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = std::size_t{1} << state.range(0);
+    const std::size_t count = std::max<std::size_t>(bytes / streamArrays<Op> / sizeof(Block) / 4 * 4, 4);
+    std::vector<Block> a(count, Block{{1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}});
+    std::vector<Block> b(streamArrays<Op> > 1 ? count : 0, Block{{2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f}});
+    std::vector<Block> c(streamArrays<Op> > 2 ? count : 0, Block{{0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f}});
+    const __m256 scalar = _mm256_set1_ps(3.0f);
+
+    for (auto _ : allocations.Loop())
+    {
+        auto result = StreamKernel<Op, NonTemporal>(a.data(), b.data(), c.data(), count, scalar);
+        benchmark::DoNotOptimize(result);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * count * sizeof(Block) * streamArrays<Op>));
+    state.SetLabel(CacheLevelName(bytes, state.threads()));
+}
+
+//Enough independent FMA chains to cover latency times the number of FMA ports
+static void BM_PeakFma(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    constexpr int accumulators = 12;
+    constexpr int loops = 1024;
+    __m256 acc[accumulators];
+    for (int i = 0; i < accumulators; i++)
+    {
+        acc[i] = _mm256_set1_ps(static_cast<float>(i));
+    }
+    const __m256 mul = _mm256_set1_ps(0.999f);
+    const __m256 add = _mm256_set1_ps(0.001f);
+    for (auto _ : allocations.Loop())
+    {
+        for (int i = 0; i < loops; i++)
+        {
+            for (int j = 0; j < accumulators; j++)
+            {
+                acc[j] = _mm256_fmadd_ps(acc[j], mul, add);
+            }
+        }
+        for (int j = 0; j < accumulators; j++)
+        {
+            benchmark::DoNotOptimize(acc[j]);
+        }
+    }
+    state.counters["flops"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * loops * accumulators * 8 * 2, benchmark::Counter::kIsRate);
+}
+
+static void ThreadSweep(benchmark::internal::Benchmark* b)
+{
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads < hardwareThreads; threads *= 2)
+    {
+        b->Threads(threads);
+    }
+    b->Threads(hardwareThreads);
+}
+
+static void StreamArguments(benchmark::internal::Benchmark* b)
+{
+    const auto& topology = GetCacheTopology();
+    b->DenseRange(std::max(12, Log2Floor(topology.L1().size) - 2), Log2Ceil(topology.LLC().size) + 2);
+}
+
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Read, false)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Read, true)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Write, false)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Write, true)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Copy, false)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Copy, true)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Scale, false)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Scale, true)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Triad, false)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP_TEMPLATE(BM_Stream, StreamOp::Triad, true)
+    ->Apply(StreamArguments)->ApplyThreads(ThreadSweep)->UseRealTime();
+BENCH_SWEEP(BM_PeakFma)->ApplyThreads(ThreadSweep)->UseRealTime();
+
+#endif
+
+//Keeps the best bandwidth per cache level and the best FMA throughput per thread count
+class RooflineReporter : public benchmark::ConsoleReporter
+{
+public:
+    void ReportRuns(const std::vector<Run>& reports) override
+    {
+        ConsoleReporter::ReportRuns(reports);
+        for (const auto& run : reports)
+        {
+            if (run.error_occurred || run.run_type != Run::RT_Iteration)
+            {
+                continue;
+            }
+            if (const auto flops = run.counters.find("flops"); flops != run.counters.end())
+            {
+                auto& peak = m_Peak[run.threads];
+                peak = std::max(peak, flops->second.value);
+            }
+            else if (const auto bytes = run.counters.find("bytes_per_second"); bytes != run.counters.end())
+            {
+                auto& ceiling = m_Bandwidth[{LevelOrder(run.report_label), run.threads}];
+                if (bytes->second.value > ceiling.bytesPerSecond)
+                {
+                    ceiling = {bytes->second.value, run.report_label, run.run_name.function_name};
+                }
+            }
+        }
+    }
+
+    void PrintRoofline(std::ostream& os) const
+    {
+        os << "\nRoofline (bandwidth ceilings in GB/s, ridge point in FLOP/byte)\n";
+        for (const auto& [key, ceiling] : m_Bandwidth)
+        {
+            os << std::setw(5) << ceiling.level << " threads:" << std::setw(3) << key.second << std::setw(10)
+               << std::fixed << std::setprecision(1) << ceiling.bytesPerSecond / 1e9 << " GB/s";
+            if (const auto peak = m_Peak.find(key.second); peak != m_Peak.end())
+            {
+                os << "  ridge " << std::setprecision(2) << peak->second / ceiling.bytesPerSecond;
+            }
+            os << "  (" << ceiling.kernel << ")\n";
+        }
+        for (const auto& [threads, flops] : m_Peak)
+        {
+            os << " peak threads:" << std::setw(3) << threads << std::setw(10) << std::setprecision(1) << flops / 1e9
+               << " GFLOP/s\n";
+        }
+        os.unsetf(std::ios::floatfield);
+    }
+
+    void WriteRooflineJson(std::ostream& os) const
+    {
+        os << "{\n  \"compute_peak\": [";
+        bool first = true;
+        for (const auto& [threads, flops] : m_Peak)
+        {
+            os << (first ? "" : ", ") << "{\"threads\": " << threads << ", \"flops_per_second\": " << flops << '}';
+            first = false;
+        }
+        os << "],\n  \"bandwidth\": [";
+        first = true;
+        for (const auto& [key, ceiling] : m_Bandwidth)
+        {
+            os << (first ? "\n" : ",\n") << "    {\"level\": \"" << ceiling.level << "\", \"threads\": " << key.second
+               << ", \"bytes_per_second\": " << ceiling.bytesPerSecond << ", \"kernel\": \"" << ceiling.kernel
+               << "\"}";
+            first = false;
+        }
+        os << "\n  ]\n}\n";
+    }
+
+private:
+    struct Ceiling
+    {
+        double bytesPerSecond = 0.0;
+        std::string level;
+        std::string kernel;
+    };
+
+    static int LevelOrder(const std::string& level)
+    {
+        return level == "L1" ? 0 : level == "L2" ? 1 : level == "LLC" ? 2 : 3;
+    }
+
+    std::map<std::pair<int, int64_t>, Ceiling> m_Bandwidth;
+    std::map<int64_t, double> m_Peak;
+};
+
+#ifndef BENCH_DRIVER
+//Usage: bench_stream [--roofline_out=<file.json>] [benchmark flags]
+int main(int argc, char** argv)
+{
+    const char* rooflinePath = nullptr;
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "--roofline_out=", 15) == 0)
+        {
+            rooflinePath = argv[i] + 15;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    AddCacheTopologyContext();
+    const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv);
+    if (!ConfigureSweeps(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    RooflineReporter reporter;
+    RunHarnessedBenchmarks(harnessOptions, &reporter);
+    reporter.PrintRoofline(std::cout);
+    if (rooflinePath != nullptr)
+    {
+        std::ofstream json(rooflinePath);
+        reporter.WriteRooflineJson(json);
+    }
+    benchmark::Shutdown();
+    return 0;
+}
+#endif
@@ -1,8 +1,12 @@
 
 
 #include "benchmark/benchmark.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
 
 void BM_add(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     srand(1);
     const unsigned int N = state.range(0);
@@ -13,7 +17,7 @@ void BM_add(benchmark::State& state) {
     }
     unsigned long* p1 = v1.data();
     unsigned long* p2 = v2.data();
-    for (auto _ : state) {
+    for (auto _ : allocations.Loop()) {
         unsigned long a1 = 0, a2 = 0;
         for (size_t i = 0; i < N; ++i) {
             a1 += p1[i] + p2[i];
@@ -24,9 +28,10 @@ void BM_add(benchmark::State& state) {
     }
     state.SetItemsProcessed(N * state.iterations());
 }
-BENCHMARK(BM_add)->Arg(1 << 22);
+BENCH_SWEEP(BM_add)->Arg(1 << 22);
 
 void BM_multiply(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     srand(1);
     const unsigned int N = state.range(0);
@@ -37,7 +42,7 @@ void BM_multiply(benchmark::State& state) {
     }
     unsigned long* p1 = v1.data();
     unsigned long* p2 = v2.data();
-    for (auto _ : state) {
+    for (auto _ : allocations.Loop()) {
         unsigned long a1 = 0, a2 = 0;
         for (size_t i = 0; i < N; ++i) {
             a2 += p1[i] * p2[i];
@@ -48,9 +53,10 @@ void BM_multiply(benchmark::State& state) {
     }
     state.SetItemsProcessed(N * state.iterations());
 }
-BENCHMARK(BM_multiply)->Arg(1 << 22);
+BENCH_SWEEP(BM_multiply)->Arg(1 << 22);
 
 void BM_add_multiply(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     srand(1);
     const unsigned int N = state.range(0);
@@ -61,7 +67,7 @@ void BM_add_multiply(benchmark::State& state) {
     }
     unsigned long* p1 = v1.data();
     unsigned long* p2 = v2.data();
-        for (auto _ : state) {
+        for (auto _ : allocations.Loop()) {
             unsigned long a1 = 0, a2 = 0;
             for (size_t i = 0; i < N; ++i) {
                 a1 += p1[i] + p2[i];
@@ -73,9 +79,10 @@ void BM_add_multiply(benchmark::State& state) {
         }
     state.SetItemsProcessed(N * state.iterations());
 }
-BENCHMARK(BM_add_multiply)->Arg(1 << 22);
+BENCH_SWEEP(BM_add_multiply)->Arg(1 << 22);
 
 void BM_add_multiply_sub_shift(benchmark::State& state) {
+    AllocationCounters allocations(state);
 
     srand(1);
     const unsigned int N = state.range(0);
@@ -86,7 +93,7 @@ void BM_add_multiply_sub_shift(benchmark::State& state) {
     }
     unsigned long* p1 = v1.data();
     unsigned long* p2 = v2.data();
-    for (auto _ : state) {
+    for (auto _ : allocations.Loop()) {
         unsigned long a1 = 0, a2 = 0, a3 = 0, a4 = 0;
         for (size_t i = 0; i < N; ++i) {
             a1 += p1[i] + p2[i];
@@ -102,4 +109,6 @@ void BM_add_multiply_sub_shift(benchmark::State& state) {
     }
     state.SetItemsProcessed(N * state.iterations());
 }
-BENCHMARK(BM_add_multiply_sub_shift)->Arg(1 << 22);
+BENCH_SWEEP(BM_add_multiply_sub_shift)->Arg(1 << 22);
+
+BENCH_HARNESS_MAIN();
@@ -0,0 +1,183 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "cycle_clock.h"
+#include "perf_counters.h"
+#include "alloc_tracker.h"
+#include "harness.h"
+#include "sweep.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+
+constexpr std::size_t smallPageSize = 4 * 1024;
+constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+
+enum PageMode : long
+{
+    SmallPages = 0,
+    TransparentHugePages = 1,
+    HugeTlbPages = 2,
+};
+
+static std::size_t AvailableMemory()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    std::size_t value = 0;
+    std::string unit;
+    while (meminfo >> key >> value >> unit)
+    {
+        if (key == "MemAvailable:")
+        {
+            return value * 1024;
+        }
+    }
+    return 0;
+}
+
+class PageRegion
+{
+public:
+    PageRegion(std::size_t bytes, PageMode mode) : m_Bytes(bytes)
+    {
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | (mode == HugeTlbPages ? MAP_HUGETLB : 0);
+        //hugetlb mappings are whole huge pages, munmap rejects a length that is not. The THP region is
+        //over-allocated by one huge page so that it can start on a 2MB boundary.
+        m_MappedBytes = mode == HugeTlbPages ? (bytes + hugePageSize - 1) / hugePageSize * hugePageSize
+                                             : bytes + hugePageSize;
+        void* ptr = mmap(nullptr, m_MappedBytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return;
+        }
+        m_Mapping = static_cast<char*>(ptr);
+        const auto address = reinterpret_cast<std::uintptr_t>(m_Mapping);
+        m_Data = mode == HugeTlbPages ? m_Mapping
+            : m_Mapping + ((hugePageSize - address % hugePageSize) % hugePageSize);
+        if (mode == SmallPages)
+        {
+            madvise(m_Data, m_Bytes, MADV_NOHUGEPAGE);
+        }
+        else if (mode == TransparentHugePages)
+        {
+            madvise(m_Data, m_Bytes, MADV_HUGEPAGE);
+        }
+        std::memset(m_Data, 0, m_Bytes);
+    }
+    ~PageRegion()
+    {
+        if (m_Mapping != nullptr && munmap(m_Mapping, m_MappedBytes) != 0)
+        {
+            std::fprintf(stderr, "BM_TlbReach: munmap of %zu bytes failed: %s\n", m_MappedBytes, std::strerror(errno));
+        }
+    }
+    PageRegion(const PageRegion&) = delete;
+    PageRegion& operator=(const PageRegion&) = delete;
+
+    [[nodiscard]] char* Data() const { return m_Data; }
+private:
+    std::size_t m_Bytes = 0;
+    std::size_t m_MappedBytes = 0;
+    char* m_Mapping = nullptr;
+    char* m_Data = nullptr;
+};
+
+//Walks one cache line per 4K page in random page order with dependent loads, so
+//every access needs its own translation whatever the page size backing the region
+static void BM_TlbReach(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t bytes = static_cast<std::size_t>(state.range(0)) * 1024 * 1024;
+    const auto mode = static_cast<PageMode>(state.range(1));
+    if (bytes * 2 > AvailableMemory())
+    {
+        state.SkipWithError("not enough available memory for region");
+        return;
+    }
+    PageRegion region(bytes, mode);
+    if (region.Data() == nullptr)
+    {
+        state.SkipWithError(mode == HugeTlbPages ? "mmap(MAP_HUGETLB) failed, reserve pages in /proc/sys/vm/nr_hugepages"
+                                                 : "mmap failed");
+        return;
+    }
+
+    const std::size_t pages = bytes / smallPageSize;
+    std::vector<std::size_t> order(pages);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(42);
+    std::shuffle(order.begin() + 1, order.end(), gen);
+    //Rotating the line inside the page spreads the walk over every cache set
+    const auto slot = [&](std::size_t page) {
+        return region.Data() + page * smallPageSize + (page % (smallPageSize / 64)) * 64;
+    };
+    for (std::size_t i = 0; i < pages; i++)
+    {
+        *reinterpret_cast<char**>(slot(order[i])) = slot(order[(i + 1) % pages]);
+    }
+
+    PerfCounter tlbMisses(PerfEvent::DTLBReadMiss);
+    PerfCounter tlbAccesses(PerfEvent::DTLBReadAccess);
+    //Core cycles, so turbo does not skew the page modes against each other, TSC reference cycles without perf
+    PerfCounter coreCycles(PerfEvent::Cycles);
+    const bool referenceCycles = !coreCycles.IsValid();
+    char* current = slot(order[0]);
+    std::uint64_t cycles = 0;
+    tlbMisses.Start();
+    tlbAccesses.Start();
+    coreCycles.Start();
+    for (auto _ : allocations.Loop())
+    {
+        const std::uint64_t start = referenceCycles ? ReadCycles() : 0;
+        for (std::size_t i = 0; i < pages; i++)
+        {
+            current = *reinterpret_cast<char**>(current);
+        }
+        if (referenceCycles)
+        {
+            cycles += ReadCycles() - start;
+        }
+        benchmark::DoNotOptimize(current);
+    }
+    coreCycles.Stop();
+    tlbMisses.Stop();
+    tlbAccesses.Stop();
+    if (!referenceCycles)
+    {
+        cycles = coreCycles.Read();
+    }
+
+    const double accesses = static_cast<double>(pages) * static_cast<double>(state.iterations());
+    state.SetItemsProcessed(static_cast<int64_t>(accesses));
+    state.counters["cycles_per_access"] = static_cast<double>(cycles) / accesses;
+    state.counters["reference_cycles"] = referenceCycles ? 1 : 0;
+    if (tlbMisses.IsValid())
+    {
+        state.counters["dtlb_miss_per_access"] = static_cast<double>(tlbMisses.Read()) / accesses;
+    }
+    if (tlbMisses.IsValid() && tlbAccesses.IsValid() && tlbAccesses.Read() != 0)
+    {
+        state.counters["dtlb_miss_rate"] =
+            static_cast<double>(tlbMisses.Read()) / static_cast<double>(tlbAccesses.Read());
+    }
+    static const char* modeNames[] = {"4k", "thp", "hugetlb"};
+    state.SetLabel(std::string(modeNames[mode]) + " " +
+                   (bytes >= 1024 * 1024 * 1024 ? std::to_string(bytes >> 30) + "gb"
+                                                : std::to_string(bytes >> 20) + "mb"));
+}
+
+//Region size in MB from 1MB to 4GB, for each page mode
+BENCH_SWEEP(BM_TlbReach)
+    ->ArgsProduct({benchmark::CreateRange(1, 4096, 2), {SmallPages, TransparentHugePages, HugeTlbPages}})
+    ->ArgNames({"mb", "mode"});
+#endif
+
+BENCH_HARNESS_MAIN();
@@ -1,7 +1,10 @@
 
-#include "random_utils.h"
 #include <benchmark/benchmark.h>
+#include <algorithm>
 #include <memory>
+#include <numeric>
+#include <span>
+#include <thread>
 #include <vector>
 
 #include <random>
@@ -13,6 +16,11 @@ const long toRange = 1 << 22;
 
 
 #include <cmath>
+#include "radix_sort.h"
+#include "alloc_tracker.h"
+#include "dataset_cache.h"
+#include "harness.h"
+#include "sweep.h"
 
 
 class Shape
@@ -70,22 +78,59 @@ private:
     float height_ = 0.0f;
 };
 
+struct ShapeParameters
+{
+    float radius;
+    float width;
+    float height;
+};
+
+//One circle and one rect per entry, generated once and shared by every benchmark below
+static std::span<const ShapeParameters> ShapeDataset(std::size_t count)
+{
+    return CachedDataset<ShapeParameters>("vtable_shapes", count, 1, [](std::span<ShapeParameters> shapes, std::mt19937_64& gen)
+    {
+        std::uniform_real_distribution<float> dis(0.0f, 100.0f);
+        for (auto& shape : shapes)
+        {
+            shape.radius = dis(gen);
+            shape.width = dis(gen);
+            shape.height = dis(gen);
+        }
+    });
+}
+
+static std::span<const std::uint32_t> ShuffledOrder(std::size_t length)
+{
+    return CachedDataset<std::uint32_t>("vtable_order", length, 1, [](std::span<std::uint32_t> order, std::mt19937_64& gen)
+    {
+        std::iota(order.begin(), order.end(), 0u);
+        std::shuffle(order.begin(), order.end(), gen);
+    });
+}
+
 
 static void BM_01_Vtable(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
+    const auto shapes = ShapeDataset(length / 2);
+    std::vector<std::unique_ptr<Shape>> allocated;
+    allocated.reserve(length);
+    for (const auto& shape : shapes)
+    {
+        allocated.push_back(std::make_unique<Circle>(shape.radius));
+        allocated.push_back(std::make_unique<Rect>(shape.width, shape.height));
+    }
+    //Shuffling the pointers keeps the allocation order, so the traversal jumps around the heap
     std::vector<std::unique_ptr<Shape>> v1;
     v1.reserve(length);
-    for (std::size_t i = 0; i < length/2; i++)
+    for (const auto index : ShuffledOrder(allocated.size()))
     {
-        v1.push_back(std::make_unique<Circle>(RandomRange(0.0f, 100.0f)));
-        v1.push_back(std::make_unique<Rect>(RandomRange(0.0f, 100.0f), RandomRange(0.0f, 100.0f)));
+        v1.push_back(std::move(allocated[index]));
     }
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(v1.begin(), v1.end(), g);
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         float a1 = 0, a2 = 0;
         for (const auto& v: v1)
@@ -101,23 +146,25 @@ static void BM_01_Vtable(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Vtable)->Range(fromRange, toRange);
+BENCH_SWEEP(BM_01_Vtable)->Range(fromRange, toRange);
 
 static void BM_01_Vtable_Sorted(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
     std::vector<std::unique_ptr<Shape>> v1;
     v1.reserve(length);
-    for (std::size_t i = 0; i < length / 2; i++)
+    const auto shapes = ShapeDataset(length / 2);
+    for (const auto& shape : shapes)
     {
-        v1.push_back(std::make_unique<Circle>(RandomRange(0.0f, 100.0f)));
+        v1.push_back(std::make_unique<Circle>(shape.radius));
     }
 
-    for (std::size_t i = 0; i < length / 2; i++)
+    for (const auto& shape : shapes)
     {
-        v1.push_back(std::make_unique<Rect>(RandomRange(0.0f, 100.0f), RandomRange(0.0f, 100.0f)));
+        v1.push_back(std::make_unique<Rect>(shape.width, shape.height));
     }
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         float a1 = 0, a2 = 0;
         for (const auto& v: v1)
@@ -133,22 +180,23 @@ static void BM_01_Vtable_Sorted(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Vtable_Sorted)->Range(fromRange, toRange);
+BENCH_SWEEP(BM_01_Vtable_Sorted)->Range(fromRange, toRange);
 
 static void BM_01_Vtable_Separate(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
     std::vector<std::unique_ptr<Circle>> v1;
     v1.reserve(length / 2);
     std::vector<std::unique_ptr<Rect>> v2;
     v2.reserve(length / 2);
-    for (std::size_t i = 0; i < length / 2; i++)
+    for (const auto& shape : ShapeDataset(length / 2))
     {
-        v1.push_back(std::make_unique<Circle>(RandomRange(0.0f, 100.0f)));
-        v2.push_back(std::make_unique<Rect>(RandomRange(0.0f, 100.0f), RandomRange(0.0f, 100.0f)));
+        v1.push_back(std::make_unique<Circle>(shape.radius));
+        v2.push_back(std::make_unique<Rect>(shape.width, shape.height));
     }
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         float a1 = 0, a2 = 0;
         for (const auto& circle: v1)
@@ -169,23 +217,24 @@ static void BM_01_Vtable_Separate(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Vtable_Separate)->Range(fromRange, toRange);
+BENCH_SWEEP(BM_01_Vtable_Separate)->Range(fromRange, toRange);
 
 
 static void BM_01_Vtable_Val(benchmark::State& state)
 {
+    AllocationCounters allocations(state);
     const std::size_t length = state.range(0);
     std::vector<Circle> v1;
     v1.reserve(length / 2);
     std::vector<Rect> v2;
     v2.reserve(length / 2);
-    for (std::size_t i = 0; i < length / 2; i++)
+    for (const auto& shape : ShapeDataset(length / 2))
     {
-        v1.emplace_back(RandomRange(0.0f, 100.0f));
-        v2.emplace_back(RandomRange(0.0f, 100.0f), RandomRange(0.0f, 100.0f));
+        v1.emplace_back(shape.radius);
+        v2.emplace_back(shape.width, shape.height);
     }
 
-    for (auto _ : state)
+    for (auto _ : allocations.Loop())
     {
         float a1 = 0, a2 = 0;
         for (const auto& circle: v1)
@@ -206,4 +255,102 @@ static void BM_01_Vtable_Val(benchmark::State& state)
 
 }
 
-BENCHMARK(BM_01_Vtable_Val)->Range(fromRange, toRange);
\ No newline at end of file
+BENCH_SWEEP(BM_01_Vtable_Val)->Range(fromRange, toRange);
+
+enum ShapeOrder : long
+{
+    ShapeShuffled = 0,
+    //Grouped by type with a radix partition, still in random heap order inside a type
+    ShapePartitioned = 1,
+    ShapeParallelPartitioned = 2,
+    //Radix sorted on type then allocation index: grouped by type and walking the heap forward
+    ShapeSortedByTypeAndAddress = 3,
+};
+
+//BM_01_Vtable with the shuffled pointers reordered by type at the start of every iteration, followed by
+//`reuse` passes over them, so the sort cost is weighed against the predictable indirect calls
+static void BM_02_Vtable_Partitioned(benchmark::State& state)
+{
+    AllocationCounters allocations(state);
+    const std::size_t length = state.range(0) / 2 * 2;
+    const long reuse = state.range(1);
+    const auto order = static_cast<ShapeOrder>(state.range(2));
+    const auto shapes = ShapeDataset(length / 2);
+    std::vector<std::unique_ptr<Shape>> allocated;
+    allocated.reserve(length);
+    for (const auto& shape : shapes)
+    {
+        allocated.push_back(std::make_unique<Circle>(shape.radius));
+        allocated.push_back(std::make_unique<Rect>(shape.width, shape.height));
+    }
+    //Types are known when the shapes are created, no RTTI needed
+    std::vector<Shape*> shuffled;
+    std::vector<std::uint8_t> types;
+    std::vector<std::uint32_t> typeAndAddress;
+    shuffled.reserve(length);
+    types.reserve(length);
+    typeAndAddress.reserve(length);
+    for (const auto index : ShuffledOrder(length))
+    {
+        const std::uint32_t type = index % 2;
+        shuffled.push_back(allocated[index].get());
+        types.push_back(static_cast<std::uint8_t>(type));
+        typeAndAddress.push_back(type << 31 | index);
+    }
+    std::vector<Shape*> ordered(length);
+    std::vector<std::uint32_t> keys(length);
+    std::vector<std::uint32_t> keyScratch(length);
+    std::vector<Shape*> shapeScratch(length);
+    std::unique_ptr<WorkStealingPool> pool;
+    if (order == ShapeParallelPartitioned)
+    {
+        pool = std::make_unique<WorkStealingPool>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    for (auto _ : allocations.Loop())
+    {
+        std::span<Shape* const> data = shuffled;
+        switch (order)
+        {
+        case ShapeShuffled:
+            break;
+        case ShapePartitioned:
+            RadixPartition<std::uint8_t, Shape*>(types, shuffled, ordered);
+            data = ordered;
+            break;
+        case ShapeParallelPartitioned:
+            ParallelRadixPartition<std::uint8_t, Shape*>(*pool, types, shuffled, ordered);
+            data = ordered;
+            break;
+        case ShapeSortedByTypeAndAddress:
+            std::copy(typeAndAddress.begin(), typeAndAddress.end(), keys.begin());
+            std::copy(shuffled.begin(), shuffled.end(), ordered.begin());
+            RadixSort<Shape*>(keys, ordered, keyScratch, shapeScratch);
+            data = ordered;
+            break;
+        }
+        for (long pass = 0; pass < reuse; pass++)
+        {
+            float a1 = 0, a2 = 0;
+            for (const Shape* v : data)
+            {
+                a1 += v->Area();
+                a2 += v->Perimeter();
+            }
+            benchmark::DoNotOptimize(a1);
+            benchmark::DoNotOptimize(a2);
+        }
+        benchmark::ClobberMemory();
+    }
+    static const char* orderNames[] = {"shuffled", "partitioned", "parallel_partitioned", "type_and_address"};
+    state.SetLabel(orderNames[order]);
+    state.SetItemsProcessed(length * reuse * state.iterations());
+}
+
+BENCH_SWEEP(BM_02_Vtable_Partitioned)
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 22, 16), {1, 4, 16},
+                   {ShapeShuffled, ShapePartitioned, ShapeParallelPartitioned, ShapeSortedByTypeAndAddress}})
+    ->ArgNames({"length", "reuse", "order"})
+    ->UseRealTime();
+
+BENCH_HARNESS_MAIN();
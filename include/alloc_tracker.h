@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <benchmark/benchmark.h>
+
+struct AllocationStats
+{
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t bytes = 0;
+    std::int64_t liveBytes = 0;
+    std::int64_t peakLiveBytes = 0;
+};
+
+#ifdef BENCH_TRACK_ALLOCATIONS
+
+//Implemented in src/alloc_tracker.cpp next to the global operator new/delete replacements
+namespace alloc_tracker
+{
+AllocationStats Read();
+//Restarts peak tracking from the current live bytes
+void ResetPeak();
+}
+
+//Counts heap activity of one benchmark run, split between setup (construction until the loop
+//starts) and the timed region (the loop itself). Iterate over Loop() instead of the state.
+//Counters are published from thread 0 only: the hooks are process wide.
+class AllocationCounters
+{
+public:
+    explicit AllocationCounters(benchmark::State& state) : m_State(state)
+    {
+        alloc_tracker::ResetPeak();
+        m_Start = alloc_tracker::Read();
+    }
+
+    ~AllocationCounters()
+    {
+        if (!m_Finished || m_State.thread_index() != 0)
+        {
+            return;
+        }
+        auto& counters = m_State.counters;
+        counters["setup_allocs"] = static_cast<double>(m_SetupEnd.allocations - m_Start.allocations);
+        counters["setup_frees"] = static_cast<double>(m_SetupEnd.frees - m_Start.frees);
+        counters["setup_bytes"] = static_cast<double>(m_SetupEnd.bytes - m_Start.bytes);
+        counters["setup_peak_live"] = static_cast<double>(m_SetupEnd.peakLiveBytes);
+        counters["allocs_per_iter"] = benchmark::Counter(static_cast<double>(m_TimedEnd.allocations - m_SetupEnd.allocations),
+                                                         benchmark::Counter::kAvgIterations);
+        counters["frees_per_iter"] = benchmark::Counter(static_cast<double>(m_TimedEnd.frees - m_SetupEnd.frees),
+                                                        benchmark::Counter::kAvgIterations);
+        counters["bytes_per_iter"] = benchmark::Counter(static_cast<double>(m_TimedEnd.bytes - m_SetupEnd.bytes),
+                                                        benchmark::Counter::kAvgIterations);
+        counters["timed_peak_live"] = static_cast<double>(m_TimedEnd.peakLiveBytes);
+    }
+
+    AllocationCounters(const AllocationCounters&) = delete;
+    AllocationCounters& operator=(const AllocationCounters&) = delete;
+
+    class Range
+    {
+    public:
+        struct Iterator
+        {
+            benchmark::State::StateIterator it;
+            AllocationCounters* owner;
+
+            benchmark::State::StateIterator::Value operator*() const { return *it; }
+            Iterator& operator++()
+            {
+                ++it;
+                return *this;
+            }
+            bool operator!=(const Iterator& end)
+            {
+                if (it != end.it)
+                {
+                    return true;
+                }
+                owner->m_TimedEnd = alloc_tracker::Read();
+                owner->m_Finished = true;
+                return false;
+            }
+        };
+
+        explicit Range(AllocationCounters& owner) : m_Owner(owner) {}
+        Iterator begin()
+        {
+            m_Owner.m_SetupEnd = alloc_tracker::Read();
+            alloc_tracker::ResetPeak();
+            return {m_Owner.m_State.begin(), &m_Owner};
+        }
+        Iterator end() { return {m_Owner.m_State.end(), &m_Owner}; }
+    private:
+        AllocationCounters& m_Owner;
+    };
+
+    Range Loop() { return Range(*this); }
+
+private:
+    benchmark::State& m_State;
+    AllocationStats m_Start;
+    AllocationStats m_SetupEnd;
+    AllocationStats m_TimedEnd;
+    bool m_Finished = false;
+};
+
+#else
+
+//Tracking disabled (BENCH_TRACK_ALLOCATIONS=OFF): Loop() is the plain state loop
+class AllocationCounters
+{
+public:
+    explicit AllocationCounters(benchmark::State& state) : m_State(state) {}
+    benchmark::State& Loop() { return m_State; }
+private:
+    benchmark::State& m_State;
+};
+
+#endif
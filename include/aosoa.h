@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include "intrinsics.h"
+#include "sincos.h"
+#include "vec2.h"
+
+//Lane blocks of the AOSOA layout: the same component of N consecutive entities side by side,
+//aligned so one block is one SSE (N = 4) or AVX (N = 8) register per field
+namespace AOSOA
+{
+template<size_t N>
+struct  alignas(N * sizeof(float)) NPos
+{
+    std::array<float, N> posX;
+    std::array<float, N> posY;
+    void TranslateIntrinsics(sfge::Vec2f moveValue);
+};
+#ifdef __SSE__
+template<>
+inline void NPos<4>::TranslateIntrinsics(sfge::Vec2f moveValue)
+{
+    auto x = _mm_load1_ps(&moveValue.x);
+    auto y = _mm_load1_ps(&moveValue.y);
+
+    auto px = _mm_load_ps(posX.data());
+    auto py = _mm_load_ps(posY.data());
+
+    px = _mm_add_ps(px, x);
+    py = _mm_add_ps(py, y);
+
+    _mm_store_ps(posX.data(), px);
+    _mm_store_ps(posY.data(), py);
+}
+#endif
+#ifdef __AVX__
+template<>
+inline void NPos<8>::TranslateIntrinsics(sfge::Vec2f moveValue)
+{
+    auto x = _mm256_broadcast_ss(&moveValue.x);
+    auto y = _mm256_broadcast_ss(&moveValue.y);
+
+    auto px = _mm256_load_ps(posX.data());
+    auto py = _mm256_load_ps(posY.data());
+
+    px = _mm256_add_ps(px, x);
+    py = _mm256_add_ps(py, y);
+
+    _mm256_store_ps(posX.data(), px);
+    _mm256_store_ps(posY.data(), py);
+}
+#endif
+
+template<size_t N>
+struct  alignas(N * sizeof(float)) NScale
+{
+    std::array<float, N> scaleX;
+    std::array<float, N> scaleY;
+    void ScaleIntrinsics(float scaleValue);
+};
+
+#ifdef __SSE__
+template <>
+inline void NScale<4>::ScaleIntrinsics(float scaleValue)
+{
+    auto x = _mm_load1_ps(&scaleValue);
+
+    auto px = _mm_load_ps(scaleX.data());
+    auto py = _mm_load_ps(scaleY.data());
+
+    px = _mm_mul_ps(px, x);
+    py = _mm_mul_ps(py, x);
+
+    _mm_store_ps(scaleX.data(), px);
+    _mm_store_ps(scaleY.data(), py);
+}
+#endif
+#ifdef __AVX__
+template<>
+inline void NScale<8>::ScaleIntrinsics(float scaleValue)
+{
+    auto x = _mm256_broadcast_ss(&scaleValue);
+
+    auto px = _mm256_load_ps(scaleX.data());
+    auto py = _mm256_load_ps(scaleY.data());
+
+    px = _mm256_mul_ps(px, x);
+    py = _mm256_mul_ps(py, x);
+
+    _mm256_store_ps(scaleX.data(), px);
+    _mm256_store_ps(scaleY.data(), py);
+}
+#endif
+
+//Rotated unit axes: x axis (cos, sin) and y axis (-sin, cos)
+template<size_t N>
+struct alignas(N * sizeof(float)) NBasis
+{
+    std::array<float, N> xAxisX;
+    std::array<float, N> xAxisY;
+    std::array<float, N> yAxisX;
+    std::array<float, N> yAxisY;
+};
+
+template <size_t N>
+struct  alignas(N * sizeof(float)) NAngle
+{
+    std::array<float, N> eulerAngles;
+
+    void RotateIntrinsics(float angle);
+
+    //Widest SinCosDegrees register that divides N
+    template<SinCosAccuracy A>
+    void BasisIntrinsics(NBasis<N>& basis) const
+    {
+        using Simd = typename sincos_detail::WidestFor<N>::Type;
+        for (size_t i = 0; i < N; i += Simd::width)
+        {
+            typename Simd::Vec sine;
+            typename Simd::Vec cosine;
+            SinCosDegrees<Simd, A>(Simd::Load(eulerAngles.data() + i), sine, cosine);
+            Simd::Store(basis.xAxisX.data() + i, cosine);
+            Simd::Store(basis.xAxisY.data() + i, sine);
+            Simd::Store(basis.yAxisX.data() + i, Simd::Negate(sine));
+            Simd::Store(basis.yAxisY.data() + i, cosine);
+        }
+    }
+};
+
+#ifdef __SSE__
+template<>
+inline void NAngle<4>::RotateIntrinsics(float angle)
+{
+    auto a = _mm_load1_ps(&angle);
+    auto as = _mm_load_ps(eulerAngles.data());
+
+    as = _mm_add_ps(a, as);
+
+    _mm_store_ps(eulerAngles.data(), as);
+}
+#endif
+#ifdef __AVX__
+template<>
+inline void NAngle<8>::RotateIntrinsics(float angle)
+{
+    auto a = _mm256_broadcast_ss(&angle);
+    auto as = _mm256_load_ps(eulerAngles.data());
+
+    as = _mm256_add_ps(a, as);
+
+    _mm256_store_ps(eulerAngles.data(), as);
+}
+#endif
+}
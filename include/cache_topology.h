@@ -0,0 +1,422 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+struct CacheLevel
+{
+    int level = 0;
+    std::string type; //Data, Instruction or Unified
+    std::size_t size = 0;
+    std::size_t lineSize = 0;
+    std::size_t ways = 0;
+    std::size_t sets = 0;
+
+    //Addresses that are a multiple of the critical stride apart map to the same set. With the sets unknown the
+    //size is used, a multiple of the critical stride whatever the associativity.
+    [[nodiscard]] std::size_t CriticalStride() const { return sets != 0 ? sets * lineSize : size; }
+};
+
+struct CacheProbe
+{
+    bool done = false;
+    std::size_t lineSize = 0;
+    std::size_t l1Ways = 0;
+    std::vector<std::size_t> capacities;
+    std::vector<std::pair<std::size_t, double>> latencies; //working set bytes, ns per load
+};
+
+struct CacheTopology
+{
+    std::vector<CacheLevel> levels; //Data and Unified caches, sorted by level
+    bool fromSysfs = false;
+    CacheProbe probe;
+
+    [[nodiscard]] std::size_t LineSize() const { return levels.empty() ? 64 : levels.front().lineSize; }
+    [[nodiscard]] const CacheLevel& L1() const { return levels.front(); }
+    [[nodiscard]] const CacheLevel& L2() const { return levels.size() > 1 ? levels[1] : levels.front(); }
+    [[nodiscard]] const CacheLevel& LLC() const { return levels.back(); }
+};
+
+namespace cache_topology_detail
+{
+inline bool ReadValue(const std::string& path, std::string& value)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::getline(file, value);
+    return !value.empty();
+}
+
+//sysfs sizes are written as "48K", "2048K" or "105M"
+inline std::size_t ParseSize(const std::string& value)
+{
+    std::size_t pos = 0;
+    std::size_t result = 0;
+    while (pos < value.size() && value[pos] >= '0' && value[pos] <= '9')
+    {
+        result = result * 10 + static_cast<std::size_t>(value[pos] - '0');
+        pos++;
+    }
+    if (pos < value.size())
+    {
+        switch (value[pos])
+        {
+        case 'K': result <<= 10; break;
+        case 'M': result <<= 20; break;
+        case 'G': result <<= 30; break;
+        default: break;
+        }
+    }
+    return result;
+}
+
+inline std::vector<CacheLevel> DefaultLevels()
+{
+    return {
+        {1, "Data", 32 * 1024, 64, 8, 64},
+        {2, "Unified", 256 * 1024, 64, 4, 1024},
+        {3, "Unified", 8 * 1024 * 1024, 64, 16, 8192},
+    };
+}
+
+inline std::string FormatBytes(std::size_t bytes)
+{
+    if (bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0)
+    {
+        return std::to_string(bytes / 1024 / 1024) + "mb";
+    }
+    if (bytes >= 1024)
+    {
+        return std::to_string(bytes / 1024) + "kb";
+    }
+    return std::to_string(bytes) + "b";
+}
+
+//Average latency of a dependent load chain visiting bytes/stride slots in random order
+inline double ChaseLatency(std::size_t bytes, std::size_t stride, std::size_t minAccesses = 1 << 20)
+{
+    const std::size_t slotWords = std::max<std::size_t>(stride / sizeof(std::size_t), 1);
+    const std::size_t count = std::max<std::size_t>(bytes / stride, 1);
+    std::vector<std::size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(42);
+    std::shuffle(order.begin() + 1, order.end(), gen);
+
+    std::vector<std::size_t> nodes(count * slotWords);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        nodes[order[i] * slotWords] = order[(i + 1) % count] * slotWords;
+    }
+
+    const std::size_t accesses = std::max(count * 4, minAccesses);
+    std::size_t index = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        index = nodes[index];
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < accesses; i++)
+    {
+        index = nodes[index];
+    }
+    const auto end = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(index);
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(accesses);
+}
+
+//Streams over the buffer touching one int every stride bytes
+inline double StrideCost(const std::vector<int>& buffer, std::size_t stride)
+{
+    const std::size_t step = std::max<std::size_t>(stride / sizeof(int), 1);
+    long sum = 0;
+    std::size_t accesses = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 4; repeat++)
+    {
+        for (std::size_t i = 0; i < buffer.size(); i += step)
+        {
+            sum += buffer[i];
+            accesses++;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(sum);
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(accesses);
+}
+}
+
+inline std::vector<CacheLevel> ReadSysfsCacheLevels(int cpu = 0)
+{
+    using namespace cache_topology_detail;
+    std::vector<CacheLevel> levels;
+    const std::string root = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index";
+    for (int index = 0;; index++)
+    {
+        const std::string dir = root + std::to_string(index) + "/";
+        std::string value;
+        if (!ReadValue(dir + "level", value))
+        {
+            break;
+        }
+        CacheLevel level;
+        level.level = static_cast<int>(ParseSize(value));
+        ReadValue(dir + "type", level.type);
+        if (ReadValue(dir + "size", value))
+        {
+            level.size = ParseSize(value);
+        }
+        if (ReadValue(dir + "coherency_line_size", value))
+        {
+            level.lineSize = ParseSize(value);
+        }
+        if (ReadValue(dir + "ways_of_associativity", value))
+        {
+            level.ways = ParseSize(value);
+        }
+        if (ReadValue(dir + "number_of_sets", value))
+        {
+            level.sets = ParseSize(value);
+        }
+        if (level.type == "Instruction" || level.size == 0)
+        {
+            continue;
+        }
+        if (level.lineSize == 0)
+        {
+            level.lineSize = 64;
+        }
+        if (level.sets == 0 && level.ways == 0)
+        {
+            //Some kernels and VMs leave out both, take the ways of the default level
+            const auto defaults = DefaultLevels();
+            const auto same = std::find_if(defaults.begin(), defaults.end(),
+                                           [&](const CacheLevel& d) { return d.level == level.level; });
+            level.ways = same != defaults.end() ? same->ways : defaults.back().ways;
+        }
+        if (level.sets == 0 && level.ways != 0)
+        {
+            level.sets = std::max<std::size_t>(1, level.size / (level.ways * level.lineSize));
+        }
+        levels.push_back(level);
+    }
+    std::sort(levels.begin(), levels.end(),
+              [](const CacheLevel& a, const CacheLevel& b) { return a.level < b.level; });
+    return levels;
+}
+
+inline int Log2Floor(std::size_t value)
+{
+    int result = 0;
+    while (value > 1)
+    {
+        value >>= 1;
+        result++;
+    }
+    return result;
+}
+
+inline int Log2Ceil(std::size_t value)
+{
+    const int floor = Log2Floor(value);
+    return (std::size_t{1} << floor) == value ? floor : floor + 1;
+}
+
+//Cheap sysfs-based topology, safe to use from benchmark registration
+inline const CacheTopology& GetCacheTopology()
+{
+    static const CacheTopology topology = []()
+    {
+        CacheTopology result;
+        result.levels = ReadSysfsCacheLevels();
+        result.fromSysfs = !result.levels.empty();
+        if (!result.fromSysfs)
+        {
+            result.levels = cache_topology_detail::DefaultLevels();
+        }
+        return result;
+    }();
+    return topology;
+}
+
+//Measures line size, L1 ways and the capacity of each level. Takes a few seconds.
+inline CacheProbe ProbeCacheTopology(const CacheTopology& reference)
+{
+    using namespace cache_topology_detail;
+    CacheProbe probe;
+
+    {
+        std::vector<int> buffer(2 * reference.L2().size / sizeof(int), 1);
+        double previous = StrideCost(buffer, 4);
+        for (std::size_t stride = 8; stride <= 512; stride *= 2)
+        {
+            const double cost = StrideCost(buffer, stride);
+            //Once every access touches a new line, doubling the stride stops making accesses dearer
+            if (probe.lineSize == 0 && cost < previous * 1.15 && stride > 16)
+            {
+                probe.lineSize = stride / 2;
+            }
+            previous = cost;
+        }
+        if (probe.lineSize == 0)
+        {
+            probe.lineSize = 512;
+        }
+    }
+
+    {
+        //Lines one L1 apart all fall into the same set, the latency jumps past the number of ways
+        const std::size_t l1 = reference.L1().size;
+        const double base = ChaseLatency(l1, l1, 1 << 18);
+        for (std::size_t lines = 2; lines <= 32; lines++)
+        {
+            if (ChaseLatency(lines * l1, l1, 1 << 18) > base * 1.5)
+            {
+                probe.l1Ways = lines - 1;
+                break;
+            }
+        }
+    }
+
+    const std::size_t maxBytes = 2 * reference.LLC().size;
+    for (std::size_t bytes = 4 * 1024; bytes <= maxBytes; bytes *= 2)
+    {
+        probe.latencies.emplace_back(bytes, ChaseLatency(bytes, reference.LineSize()));
+        const std::size_t between = bytes + bytes / 2;
+        if (between <= maxBytes)
+        {
+            probe.latencies.emplace_back(between, ChaseLatency(between, reference.LineSize()));
+        }
+    }
+    bool previousJump = false;
+    for (std::size_t i = 1; i < probe.latencies.size(); i++)
+    {
+        const bool jump = probe.latencies[i].second > probe.latencies[i - 1].second * 1.3;
+        //Consecutive steps belong to the same level (TLB reach, replacement policy)
+        if (jump && !previousJump)
+        {
+            probe.capacities.push_back(probe.latencies[i - 1].first);
+        }
+        previousJump = jump;
+    }
+    probe.done = true;
+    return probe;
+}
+
+//Latency step closest to the expected size on a log scale, 0 when no step was found
+inline std::size_t NearestCapacity(const CacheProbe& probe, std::size_t expected)
+{
+    std::size_t nearest = 0;
+    int nearestDistance = 64;
+    for (const std::size_t capacity : probe.capacities)
+    {
+        const int distance = std::abs(Log2Floor(capacity) - Log2Floor(expected));
+        if (distance < nearestDistance)
+        {
+            nearest = capacity;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+//Probed values are coarse, agreeing within a factor of two is considered consistent
+inline bool IsConsistent(std::size_t expected, std::size_t measured)
+{
+    return measured != 0 && measured * 2 >= expected && measured <= expected * 2;
+}
+
+inline void WriteCacheTopologyReport(std::ostream& os, const CacheTopology& topology)
+{
+    using namespace cache_topology_detail;
+    os << "Cache topology (" << (topology.fromSysfs ? "sysfs" : "defaults") << ")\n";
+    for (std::size_t i = 0; i < topology.levels.size(); i++)
+    {
+        const auto& level = topology.levels[i];
+        os << "  L" << level.level << ' ' << level.type << ": " << FormatBytes(level.size)
+           << ", " << level.lineSize << "b lines, " << level.ways << " ways, " << level.sets
+           << " sets, critical stride " << level.CriticalStride() << "b";
+        if (topology.probe.done)
+        {
+            const std::size_t probed = NearestCapacity(topology.probe, level.size);
+            if (probed != 0)
+            {
+                os << ", probed ~" << FormatBytes(probed) << (IsConsistent(level.size, probed) ? "" : " (MISMATCH)");
+            }
+            else
+            {
+                os << ", no latency step found";
+            }
+        }
+        os << '\n';
+    }
+    if (topology.probe.done)
+    {
+        const auto& probe = topology.probe;
+        os << "  probed line size: " << probe.lineSize << "b"
+           << (probe.lineSize == topology.LineSize() ? "" : " (MISMATCH, adjacent line prefetch?)") << '\n';
+        os << "  probed L1 ways: " << probe.l1Ways << (probe.l1Ways == topology.L1().ways ? "" : " (MISMATCH)") << '\n';
+        os << "  load latency:";
+        for (const auto& [bytes, ns] : probe.latencies)
+        {
+            os << ' ' << FormatBytes(bytes) << '=' << ns << "ns";
+        }
+        os << '\n';
+    }
+}
+
+inline void WriteCacheTopologyJson(std::ostream& os, const CacheTopology& topology)
+{
+    os << "{\n  \"source\": \"" << (topology.fromSysfs ? "sysfs" : "defaults") << "\",\n  \"levels\": [\n";
+    for (std::size_t i = 0; i < topology.levels.size(); i++)
+    {
+        const auto& level = topology.levels[i];
+        os << "    {\"level\": " << level.level << ", \"type\": \"" << level.type << "\", \"size\": " << level.size
+           << ", \"line_size\": " << level.lineSize << ", \"ways\": " << level.ways << ", \"sets\": " << level.sets;
+        if (topology.probe.done)
+        {
+            os << ", \"probed_size\": " << NearestCapacity(topology.probe, level.size);
+        }
+        os << '}' << (i + 1 < topology.levels.size() ? "," : "") << '\n';
+    }
+    os << "  ]";
+    if (topology.probe.done)
+    {
+        const auto& probe = topology.probe;
+        os << ",\n  \"probe\": {\"line_size\": " << probe.lineSize << ", \"l1_ways\": " << probe.l1Ways
+           << ", \"latency_ns\": [";
+        for (std::size_t i = 0; i < probe.latencies.size(); i++)
+        {
+            os << (i == 0 ? "" : ", ") << '[' << probe.latencies[i].first << ", " << probe.latencies[i].second << ']';
+        }
+        os << "]}";
+    }
+    os << "\n}\n";
+}
+
+//Publishes the topology in the context block of every reporter (console header, JSON "context")
+inline void AddCacheTopologyContext(const CacheTopology& topology = GetCacheTopology())
+{
+    for (const auto& level : topology.levels)
+    {
+        const std::string key = "cache_L" + std::to_string(level.level);
+        benchmark::AddCustomContext(key, std::to_string(level.size) + " bytes, " + std::to_string(level.lineSize) +
+                                         " line, " + std::to_string(level.ways) + " ways, " +
+                                         std::to_string(level.sets) + " sets");
+    }
+}
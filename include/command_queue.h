@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+//Bounded lock-free rings moving batches of trivially copyable items between threads. The capacity is
+//rounded up to a power of two, positions are free-running 64-bit counters that never wrap in practice.
+//Neither side ever blocks: pushes and pops move as many items as they can and return how many.
+
+//One producer, one consumer. Each side keeps a copy of the other side's position and only reloads it when
+//the ring looks full (producer) or empty (consumer), so the shared lines are touched about once per batch.
+template<typename T>
+class SpscRing
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+public:
+    explicit SpscRing(std::size_t capacity)
+        : m_Capacity(std::bit_ceil(std::max<std::size_t>(1, capacity))), m_Slots(std::make_unique<T[]>(m_Capacity))
+    {
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    [[nodiscard]] std::size_t Capacity() const { return m_Capacity; }
+
+    std::size_t TryPush(std::span<const T> items)
+    {
+        const std::uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (m_Capacity - (tail - m_CachedHead) < items.size())
+        {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+        }
+        const std::size_t count = std::min<std::size_t>(items.size(), m_Capacity - (tail - m_CachedHead));
+        for (std::size_t i = 0; i < count; i++)
+        {
+            m_Slots[(tail + i) & (m_Capacity - 1)] = items[i];
+        }
+        m_Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    std::size_t TryPop(std::span<T> items)
+    {
+        const std::uint64_t head = m_Head.load(std::memory_order_relaxed);
+        if (m_CachedTail - head < items.size())
+        {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+        }
+        const std::size_t count = std::min<std::size_t>(items.size(), m_CachedTail - head);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            items[i] = m_Slots[(head + i) & (m_Capacity - 1)];
+        }
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    //Producer line
+    alignas(64) std::atomic<std::uint64_t> m_Tail{0};
+    std::uint64_t m_CachedHead = 0;
+    //Consumer line
+    alignas(64) std::atomic<std::uint64_t> m_Head{0};
+    std::uint64_t m_CachedTail = 0;
+    alignas(64) const std::size_t m_Capacity;
+    std::unique_ptr<T[]> m_Slots;
+};
+
+//Many producers, one consumer. A producer claims a contiguous range of positions with one CAS, then
+//publishes every slot by storing its position + 1 in the slot. The consumer stops at the first slot that is
+//not published yet, so a slow producer delays the items behind its range but never corrupts them.
+template<typename T>
+class MpscRing
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+public:
+    explicit MpscRing(std::size_t capacity)
+        : m_Capacity(std::bit_ceil(std::max<std::size_t>(1, capacity))), m_Slots(std::make_unique<Slot[]>(m_Capacity))
+    {
+    }
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    [[nodiscard]] std::size_t Capacity() const { return m_Capacity; }
+
+    std::size_t TryPush(std::span<const T> items)
+    {
+        std::uint64_t tail;
+        std::size_t count;
+        do
+        {
+            //Head first: tail is loaded later so it can not be behind it
+            const std::uint64_t head = m_Head.load(std::memory_order_acquire);
+            tail = m_Tail.load(std::memory_order_relaxed);
+            count = std::min<std::size_t>(items.size(), m_Capacity - (tail - head));
+            if (count == 0)
+            {
+                return 0;
+            }
+        } while (!m_Tail.compare_exchange_weak(tail, tail + count, std::memory_order_relaxed));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto& slot = m_Slots[(tail + i) & (m_Capacity - 1)];
+            slot.value = items[i];
+            slot.sequence.store(tail + i + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    std::size_t TryPop(std::span<T> items)
+    {
+        const std::uint64_t head = m_Head.load(std::memory_order_relaxed);
+        std::size_t count = 0;
+        while (count < items.size())
+        {
+            const auto& slot = m_Slots[(head + count) & (m_Capacity - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != head + count + 1)
+            {
+                break;
+            }
+            items[count] = slot.value;
+            count++;
+        }
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::uint64_t> sequence{0};
+        T value;
+    };
+
+    alignas(64) std::atomic<std::uint64_t> m_Tail{0};
+    alignas(64) std::atomic<std::uint64_t> m_Head{0};
+    alignas(64) const std::size_t m_Capacity;
+    std::unique_ptr<Slot[]> m_Slots;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "intrinsics.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//Timestamp counter read, ordered after all previous instructions (rdtscp).
+//Counts reference cycles at the TSC frequency, not core cycles under turbo.
+inline std::uint64_t ReadCycles()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    unsigned int aux;
+    return __rdtscp(&aux);
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DATASET_CACHE_MMAP
+#endif
+
+//Benchmark inputs generated once per (name, length, seed) and shared by every benchmark instance
+//of the process. When BENCH_DATASET_DIR is set, datasets are also written there and memory mapped
+//by the next process instead of being regenerated. The disk cache is opt-in because the generator
+//code is not part of the key: clear the directory or rename the dataset when its generator changes.
+namespace dataset_cache_detail
+{
+constexpr std::size_t headerSize = 64; //Keeps the payload of mapped files 64 bytes aligned
+constexpr char magic[8] = {'B', 'E', 'N', 'C', 'H', 'D', 'S', '1'};
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint64_t elementSize;
+    std::uint64_t length;
+    std::uint64_t seed;
+};
+static_assert(sizeof(FileHeader) <= headerSize);
+
+//Owns the bytes of one dataset, either an aligned heap block or a read-only file mapping
+class Storage
+{
+public:
+    Storage() = default;
+    ~Storage() { Release(); }
+    Storage(Storage&& other) noexcept
+        : m_Data(std::exchange(other.m_Data, nullptr)), m_Mapping(std::exchange(other.m_Mapping, nullptr)),
+          m_MappedBytes(other.m_MappedBytes)
+    {
+    }
+    Storage& operator=(Storage&& other) noexcept
+    {
+        Release();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Mapping = std::exchange(other.m_Mapping, nullptr);
+        m_MappedBytes = other.m_MappedBytes;
+        return *this;
+    }
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
+    static Storage Allocate(std::size_t bytes)
+    {
+        Storage storage;
+        storage.m_Data = ::operator new(bytes == 0 ? 1 : bytes, std::align_val_t{headerSize});
+        return storage;
+    }
+
+    [[nodiscard]] void* Data() const { return m_Data; }
+
+#ifdef DATASET_CACHE_MMAP
+    //Maps a file written by Store, returns an empty storage if it is missing or does not match
+    static Storage Map(const std::filesystem::path& path, const FileHeader& expected, std::size_t bytes)
+    {
+        Storage storage;
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return storage;
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) != headerSize + bytes)
+        {
+            close(fd);
+            return storage;
+        }
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        //Fault the pages in now so the first timed iteration does not pay for them
+        flags |= MAP_POPULATE;
+#endif
+        void* mapping = mmap(nullptr, headerSize + bytes, PROT_READ, flags, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            return storage;
+        }
+        if (std::memcmp(mapping, &expected, sizeof(FileHeader)) != 0)
+        {
+            munmap(mapping, headerSize + bytes);
+            return storage;
+        }
+        storage.m_Mapping = mapping;
+        storage.m_MappedBytes = headerSize + bytes;
+        storage.m_Data = static_cast<char*>(mapping) + headerSize;
+        return storage;
+    }
+#else
+    static Storage Map(const std::filesystem::path& path, const FileHeader& expected, std::size_t bytes)
+    {
+        std::ifstream file(path, std::ios::binary);
+        FileHeader header{};
+        if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(&header, &expected, sizeof(FileHeader)) != 0)
+        {
+            return {};
+        }
+        Storage storage = Allocate(bytes);
+        file.seekg(headerSize);
+        if (!file.read(static_cast<char*>(storage.m_Data), static_cast<std::streamsize>(bytes)))
+        {
+            return {};
+        }
+        return storage;
+    }
+#endif
+
+private:
+    void Release()
+    {
+#ifdef DATASET_CACHE_MMAP
+        if (m_Mapping != nullptr)
+        {
+            munmap(m_Mapping, m_MappedBytes);
+            m_Mapping = nullptr;
+            m_Data = nullptr;
+            return;
+        }
+#endif
+        if (m_Data != nullptr)
+        {
+            ::operator delete(m_Data, std::align_val_t{headerSize});
+            m_Data = nullptr;
+        }
+    }
+
+    void* m_Data = nullptr;
+    void* m_Mapping = nullptr;
+    std::size_t m_MappedBytes = 0;
+};
+
+//Empty, which disables the disk cache, unless BENCH_DATASET_DIR is set
+inline std::filesystem::path CacheDirectory()
+{
+    const char* dir = std::getenv("BENCH_DATASET_DIR");
+    return dir != nullptr ? std::filesystem::path(dir) : std::filesystem::path();
+}
+
+//Writes to a temporary name first so a concurrent or interrupted run never leaves a torn file
+inline void Store(const std::filesystem::path& path, const FileHeader& header, const void* data, std::size_t bytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error)
+    {
+        return;
+    }
+    //The pid keeps processes apart, the random part the threads and runs of one process
+    auto tmpPath = path;
+#ifdef DATASET_CACHE_MMAP
+    tmpPath += ".tmp" + std::to_string(getpid());
+#else
+    tmpPath += ".tmp";
+#endif
+    tmpPath += "-" + std::to_string(std::random_device()());
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        char padded[headerSize] = {};
+        std::memcpy(padded, &header, sizeof(header));
+        file.write(padded, headerSize);
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(tmpPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+struct Registry
+{
+    std::recursive_mutex mutex;
+    std::map<std::string, Storage> datasets;
+};
+
+inline Registry& GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+}
+
+//Returns the dataset, calling generate(std::span<T>, std::mt19937_64&) only when neither this process
+//nor the disk cache has it yet. The returned span stays valid until the process exits.
+template<typename T, typename Generator>
+requires std::is_trivially_copyable_v<T>
+std::span<const T> CachedDataset(const std::string& name, std::size_t length, std::uint64_t seed, Generator&& generate)
+{
+    using namespace dataset_cache_detail;
+    const std::string key = name + "_" + std::to_string(length) + "_" + std::to_string(seed) + "_" +
+                            std::to_string(sizeof(T));
+    const std::size_t bytes = length * sizeof(T);
+
+    auto& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    auto it = registry.datasets.find(key);
+    if (it == registry.datasets.end())
+    {
+        FileHeader header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.elementSize = sizeof(T);
+        header.length = length;
+        header.seed = seed;
+
+        const auto directory = CacheDirectory();
+        const auto path = directory.empty() ? directory : directory / (key + ".bin");
+        Storage storage = path.empty() ? Storage() : Storage::Map(path, header, bytes);
+        if (storage.Data() == nullptr)
+        {
+            storage = Storage::Allocate(bytes);
+            std::span<T> values(static_cast<T*>(storage.Data()), length);
+            std::uninitialized_value_construct_n(values.data(), length);
+            std::mt19937_64 gen(seed);
+            generate(values, gen);
+            if (!path.empty())
+            {
+                Store(path, header, storage.Data(), bytes);
+            }
+        }
+        it = registry.datasets.emplace(key, std::move(storage)).first;
+    }
+    return {static_cast<const T*>(it->second.Data()), length};
+}
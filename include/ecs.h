@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//Archetype ECS: entities with the same component set share an archetype, whose components are stored
+//in fixed size chunks as one column per component (the AOSOA layout with a chunk as the block).
+//Queries hand out one span per column and chunk, so systems run plain SIMD friendly loops.
+//Components must be trivially copyable, they are moved between archetypes with memcpy.
+namespace ecs
+{
+constexpr std::size_t maxComponents = 64;
+constexpr std::size_t chunkBytes = 16 * 1024;
+constexpr std::size_t columnAlignment = 64;
+//Chunk capacities are a multiple of the widest SIMD lane count so full chunks have no scalar tail
+constexpr std::uint32_t laneMultiple = 16;
+
+using ComponentMask = std::uint64_t;
+
+struct Entity
+{
+    std::uint32_t index = ~0u;
+    std::uint32_t generation = 0;
+
+    bool operator==(const Entity& rhs) const = default;
+};
+
+namespace ecs_detail
+{
+struct ComponentInfo
+{
+    std::uint32_t size;
+    std::uint32_t alignment;
+};
+
+inline std::vector<ComponentInfo>& ComponentInfos()
+{
+    static std::vector<ComponentInfo> infos;
+    return infos;
+}
+
+inline std::uint32_t RegisterComponent(std::uint32_t size, std::uint32_t alignment)
+{
+    auto& infos = ComponentInfos();
+    if (infos.size() >= maxComponents)
+    {
+        std::fprintf(stderr, "ecs: more than %zu component types\n", maxComponents);
+        std::abort();
+    }
+    infos.push_back({size, alignment});
+    return static_cast<std::uint32_t>(infos.size() - 1);
+}
+
+constexpr std::size_t AlignUp(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+//Dense id of a component type, assigned on first use
+template<typename T>
+std::uint32_t ComponentId()
+{
+    if constexpr (std::is_const_v<T>)
+    {
+        return ComponentId<std::remove_const_t<T>>();
+    }
+    else
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "components are moved with memcpy");
+        static_assert(alignof(T) <= columnAlignment);
+        static const std::uint32_t id = ecs_detail::RegisterComponent(sizeof(T), alignof(T));
+        return id;
+    }
+}
+
+template<typename... Ts>
+ComponentMask MaskOf()
+{
+    return ((ComponentMask{1} << ComponentId<Ts>()) | ... | ComponentMask{0});
+}
+
+class Archetype
+{
+public:
+    explicit Archetype(ComponentMask mask) : m_Mask(mask)
+    {
+        m_ColumnIndex.fill(-1);
+        m_AddEdges.fill(nullptr);
+        m_RemoveEdges.fill(nullptr);
+        const auto& infos = ecs_detail::ComponentInfos();
+        std::size_t rowBytes = sizeof(Entity);
+        for (std::uint32_t id = 0; id < maxComponents; id++)
+        {
+            if ((mask >> id & 1) != 0)
+            {
+                m_ColumnIndex[id] = static_cast<std::int16_t>(m_Columns.size());
+                m_Columns.push_back({id, infos[id].size, 0});
+                rowBytes += infos[id].size;
+            }
+        }
+        const std::size_t padding = (m_Columns.size() + 1) * columnAlignment;
+        const std::size_t rows = chunkBytes > padding ? (chunkBytes - padding) / rowBytes : 0;
+        m_Capacity = std::max<std::uint32_t>(laneMultiple, static_cast<std::uint32_t>(rows) / laneMultiple * laneMultiple);
+
+        //[entities][column 0][column 1]... each column starts on a cache line
+        std::size_t offset = ecs_detail::AlignUp(m_Capacity * sizeof(Entity), columnAlignment);
+        for (auto& column : m_Columns)
+        {
+            column.offset = offset;
+            offset += ecs_detail::AlignUp(std::size_t{m_Capacity} * column.size, columnAlignment);
+        }
+        m_ChunkBytes = offset;
+    }
+    ~Archetype()
+    {
+        for (auto* chunk : m_Chunks)
+        {
+            ::operator delete(chunk, std::align_val_t{columnAlignment});
+        }
+    }
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    [[nodiscard]] ComponentMask Mask() const { return m_Mask; }
+    [[nodiscard]] std::uint32_t Size() const { return m_Size; }
+    [[nodiscard]] std::uint32_t ChunkCapacity() const { return m_Capacity; }
+    [[nodiscard]] std::size_t ChunkCount() const { return (m_Size + m_Capacity - 1) / m_Capacity; }
+    [[nodiscard]] std::uint32_t ChunkSize(std::size_t chunk) const
+    {
+        return std::min<std::uint32_t>(m_Capacity, m_Size - static_cast<std::uint32_t>(chunk) * m_Capacity);
+    }
+    [[nodiscard]] bool Has(std::uint32_t id) const { return m_ColumnIndex[id] >= 0; }
+
+    [[nodiscard]] Entity* Entities(std::size_t chunk) const
+    {
+        return reinterpret_cast<Entity*>(m_Chunks[chunk]);
+    }
+    template<typename T>
+    [[nodiscard]] T* Column(std::size_t chunk) const
+    {
+        const auto& column = m_Columns[m_ColumnIndex[ComponentId<T>()]];
+        return std::assume_aligned<columnAlignment>(reinterpret_cast<T*>(m_Chunks[chunk] + column.offset));
+    }
+    [[nodiscard]] void* Element(std::uint32_t id, std::uint32_t row) const
+    {
+        const auto& column = m_Columns[m_ColumnIndex[id]];
+        return m_Chunks[row / m_Capacity] + column.offset + std::size_t{row % m_Capacity} * column.size;
+    }
+
+    //Appends an uninitialized row, chunks are kept once allocated so add/remove churn does not allocate
+    std::uint32_t PushRow(Entity entity)
+    {
+        if (m_Size == m_Chunks.size() * m_Capacity)
+        {
+            m_Chunks.push_back(static_cast<std::byte*>(::operator new(m_ChunkBytes, std::align_val_t{columnAlignment})));
+        }
+        const std::uint32_t row = m_Size++;
+        Entities(row / m_Capacity)[row % m_Capacity] = entity;
+        return row;
+    }
+
+    //Moves the last row into the hole, returns the entity that moved or an invalid entity
+    Entity RemoveRow(std::uint32_t row)
+    {
+        const std::uint32_t last = --m_Size;
+        if (row == last)
+        {
+            return {};
+        }
+        const Entity moved = Entities(last / m_Capacity)[last % m_Capacity];
+        Entities(row / m_Capacity)[row % m_Capacity] = moved;
+        for (const auto& column : m_Columns)
+        {
+            std::memcpy(Element(column.id, row), Element(column.id, last), column.size);
+        }
+        return moved;
+    }
+
+    //Copies the components both archetypes have from a row of source into a row of this archetype
+    void CopyShared(const Archetype& source, std::uint32_t sourceRow, std::uint32_t row)
+    {
+        for (const auto& column : m_Columns)
+        {
+            if (source.Has(column.id))
+            {
+                std::memcpy(Element(column.id, row), source.Element(column.id, sourceRow), column.size);
+            }
+        }
+    }
+
+    Archetype*& AddEdge(std::uint32_t id) { return m_AddEdges[id]; }
+    Archetype*& RemoveEdge(std::uint32_t id) { return m_RemoveEdges[id]; }
+
+private:
+    struct ColumnLayout
+    {
+        std::uint32_t id;
+        std::uint32_t size;
+        std::size_t offset;
+    };
+
+    ComponentMask m_Mask;
+    std::vector<ColumnLayout> m_Columns;
+    std::array<std::int16_t, maxComponents> m_ColumnIndex{};
+    std::uint32_t m_Capacity = 0;
+    std::size_t m_ChunkBytes = 0;
+    std::uint32_t m_Size = 0;
+    std::vector<std::byte*> m_Chunks;
+    //Archetype graph, caches the target of adding or removing one component
+    std::array<Archetype*, maxComponents> m_AddEdges{};
+    std::array<Archetype*, maxComponents> m_RemoveEdges{};
+};
+
+class World
+{
+public:
+    template<typename... Ts>
+    Entity Create(const Ts&... components)
+    {
+        Archetype& archetype = GetArchetype(MaskOf<Ts...>());
+        const Entity entity = NewEntity();
+        const std::uint32_t row = archetype.PushRow(entity);
+        (new (archetype.Element(ComponentId<Ts>(), row)) Ts(components), ...);
+        m_Records[entity.index].archetype = &archetype;
+        m_Records[entity.index].row = row;
+        return entity;
+    }
+
+    void Destroy(Entity entity)
+    {
+        if (!IsAlive(entity))
+        {
+            return;
+        }
+        auto& record = m_Records[entity.index];
+        RemoveFrom(*record.archetype, record.row);
+        record.archetype = nullptr;
+        record.generation++;
+        m_FreeIndices.push_back(entity.index);
+    }
+
+    [[nodiscard]] bool IsAlive(Entity entity) const
+    {
+        return entity.index < m_Records.size() && m_Records[entity.index].generation == entity.generation &&
+               m_Records[entity.index].archetype != nullptr;
+    }
+
+    template<typename T>
+    [[nodiscard]] bool Has(Entity entity) const
+    {
+        return IsAlive(entity) && m_Records[entity.index].archetype->Has(ComponentId<T>());
+    }
+
+    //nullptr when the entity is dead or does not have the component
+    template<typename T>
+    T* Get(Entity entity)
+    {
+        if (!Has<T>(entity))
+        {
+            return nullptr;
+        }
+        const auto& record = m_Records[entity.index];
+        return static_cast<T*>(record.archetype->Element(ComponentId<T>(), record.row));
+    }
+
+    //Structural change: moves the entity to the archetype with T, overwrites T if it is already there
+    template<typename T>
+    void Add(Entity entity, const T& component = {})
+    {
+        if (!IsAlive(entity))
+        {
+            return;
+        }
+        const std::uint32_t id = ComponentId<T>();
+        auto& record = m_Records[entity.index];
+        if (!record.archetype->Has(id))
+        {
+            Archetype*& edge = record.archetype->AddEdge(id);
+            if (edge == nullptr)
+            {
+                edge = &GetArchetype(record.archetype->Mask() | ComponentMask{1} << id);
+            }
+            MoveTo(entity, *edge);
+        }
+        new (record.archetype->Element(id, record.row)) T(component);
+    }
+
+    template<typename T>
+    void Remove(Entity entity)
+    {
+        const std::uint32_t id = ComponentId<T>();
+        if (!IsAlive(entity) || !m_Records[entity.index].archetype->Has(id))
+        {
+            return;
+        }
+        auto& record = m_Records[entity.index];
+        Archetype*& edge = record.archetype->RemoveEdge(id);
+        if (edge == nullptr)
+        {
+            edge = &GetArchetype(record.archetype->Mask() & ~(ComponentMask{1} << id));
+        }
+        MoveTo(entity, *edge);
+    }
+
+    //f(std::span<Ts>...) once per chunk of every archetype that has all of Ts
+    template<typename... Ts, typename F>
+    void ForEachChunk(F&& f)
+    {
+        ForEachChunk<Ts...>(0, std::numeric_limits<std::size_t>::max(), std::forward<F>(f));
+    }
+
+    //Same over the matching chunks [begin, end) in query order, to split a query over tasks
+    template<typename... Ts, typename F>
+    void ForEachChunk(std::size_t begin, std::size_t end, F&& f)
+    {
+        const ComponentMask required = MaskOf<Ts...>();
+        std::size_t first = 0;
+        for (const auto& archetype : m_Archetypes)
+        {
+            if ((archetype->Mask() & required) != required)
+            {
+                continue;
+            }
+            const std::size_t chunks = archetype->ChunkCount();
+            const std::size_t from = std::max(begin, first) - first;
+            const std::size_t to = std::min(end - first, chunks);
+            for (std::size_t chunk = from; chunk < to; chunk++)
+            {
+                const std::size_t size = archetype->ChunkSize(chunk);
+                f(std::span<Ts>(archetype->template Column<Ts>(chunk), size)...);
+            }
+            first += chunks;
+            if (first >= end)
+            {
+                return;
+            }
+        }
+    }
+
+    template<typename... Ts>
+    [[nodiscard]] std::size_t ChunkCount() const
+    {
+        const ComponentMask required = MaskOf<Ts...>();
+        std::size_t chunks = 0;
+        for (const auto& archetype : m_Archetypes)
+        {
+            if ((archetype->Mask() & required) == required)
+            {
+                chunks += archetype->ChunkCount();
+            }
+        }
+        return chunks;
+    }
+
+    //f(Ts&...) once per matching entity
+    template<typename... Ts, typename F>
+    void ForEach(F&& f)
+    {
+        ForEachChunk<Ts...>([&](std::span<Ts>... columns)
+        {
+            std::size_t size = 0;
+            ((size = columns.size()), ...);
+            for (std::size_t i = 0; i < size; i++)
+            {
+                f(columns[i]...);
+            }
+        });
+    }
+
+    [[nodiscard]] std::size_t EntityCount() const { return m_Records.size() - m_FreeIndices.size(); }
+    [[nodiscard]] std::size_t ArchetypeCount() const { return m_Archetypes.size(); }
+
+    void Reserve(std::size_t entities) { m_Records.reserve(entities); }
+
+private:
+    struct EntityRecord
+    {
+        Archetype* archetype = nullptr;
+        std::uint32_t row = 0;
+        std::uint32_t generation = 0;
+    };
+
+    Entity NewEntity()
+    {
+        if (!m_FreeIndices.empty())
+        {
+            const std::uint32_t index = m_FreeIndices.back();
+            m_FreeIndices.pop_back();
+            return {index, m_Records[index].generation};
+        }
+        m_Records.emplace_back();
+        return {static_cast<std::uint32_t>(m_Records.size() - 1), 0};
+    }
+
+    Archetype& GetArchetype(ComponentMask mask)
+    {
+        auto it = m_ArchetypeByMask.find(mask);
+        if (it != m_ArchetypeByMask.end())
+        {
+            return *it->second;
+        }
+        m_Archetypes.push_back(std::make_unique<Archetype>(mask));
+        m_ArchetypeByMask.emplace(mask, m_Archetypes.back().get());
+        return *m_Archetypes.back();
+    }
+
+    void RemoveFrom(Archetype& archetype, std::uint32_t row)
+    {
+        const Entity moved = archetype.RemoveRow(row);
+        if (moved.index != ~0u)
+        {
+            m_Records[moved.index].row = row;
+        }
+    }
+
+    void MoveTo(Entity entity, Archetype& target)
+    {
+        auto& record = m_Records[entity.index];
+        const std::uint32_t row = target.PushRow(entity);
+        target.CopyShared(*record.archetype, record.row, row);
+        RemoveFrom(*record.archetype, record.row);
+        record.archetype = &target;
+        record.row = row;
+    }
+
+    std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+    std::unordered_map<ComponentMask, Archetype*> m_ArchetypeByMask;
+    std::vector<EntityRecord> m_Records;
+    std::vector<std::uint32_t> m_FreeIndices;
+};
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include "intrinsics.h"
+
+//Open-addressing hash map in the SwissTable style: one control byte per slot, either empty, deleted or the
+//low 7 bits of the hash (H2) when full. Slots are probed 16 at a time: one SSE2 compare of a control group
+//against H2 gives every candidate slot, so most lookups touch one control line and one slot line.
+//Groups are aligned and probed in triangular order, the capacity is a power of two of at least one group.
+//Key and Value must be trivially copyable, the map never runs constructors on its slots.
+namespace flat_hash_map_detail
+{
+constexpr std::size_t groupWidth = 16;
+constexpr std::int8_t empty = -128;  //0b10000000
+constexpr std::int8_t deleted = -2;  //0b11111110
+
+//std::hash of integers is the identity on libstdc++, the finalizer of MurmurHash3 spreads every bit
+inline std::uint64_t Mix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+struct Group
+{
+    __m128i control;
+
+    explicit Group(const std::int8_t* position)
+        : control(_mm_load_si128(reinterpret_cast<const __m128i*>(position)))
+    {
+    }
+    [[nodiscard]] std::uint32_t Match(std::int8_t h2) const
+    {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(h2))));
+    }
+    [[nodiscard]] std::uint32_t MatchEmpty() const { return Match(empty); }
+    //Empty and deleted are the only negative control bytes
+    [[nodiscard]] std::uint32_t MatchEmptyOrDeleted() const
+    {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(control));
+    }
+};
+
+struct AlignedFree
+{
+    void operator()(std::byte* p) const { std::free(p); }
+};
+}
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>);
+public:
+    //Lookups issued together by FindBatch, their control and slot lines are prefetched before any is probed
+    static constexpr std::size_t batchSize = 16;
+    static constexpr std::size_t groupWidth = flat_hash_map_detail::groupWidth;
+
+    explicit FlatHashMap(std::size_t expected = 0) { Reserve(expected); }
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    [[nodiscard]] std::size_t Size() const { return m_Size; }
+    [[nodiscard]] std::size_t Capacity() const { return m_Capacity; }
+    [[nodiscard]] std::size_t MemoryBytes() const { return m_Capacity * (sizeof(Slot) + 1); }
+
+    //Grows so that expected entries fit under the 7/8 maximum load
+    void Reserve(std::size_t expected)
+    {
+        const std::size_t needed = std::bit_ceil(std::max(groupWidth, expected + expected / 7 + 1));
+        if (needed > m_Capacity)
+        {
+            Rehash(needed);
+        }
+    }
+
+    //Returns false and overwrites the value when the key is already present
+    bool Insert(const Key& key, const Value& value)
+    {
+        const std::uint64_t hash = HashOf(key);
+        if (Slot* slot = FindSlot(key, hash))
+        {
+            slot->value = value;
+            return false;
+        }
+        if (m_Size + m_Deleted + 1 > m_Capacity - m_Capacity / 8)
+        {
+            Rehash(m_Size + 1 > (m_Capacity - m_Capacity / 8) / 2 ? m_Capacity * 2 : m_Capacity);
+        }
+        InsertNew(key, value, hash);
+        return true;
+    }
+
+    [[nodiscard]] Value* Find(const Key& key)
+    {
+        Slot* slot = FindSlot(key, HashOf(key));
+        return slot != nullptr ? &slot->value : nullptr;
+    }
+    [[nodiscard]] const Value* Find(const Key& key) const { return const_cast<FlatHashMap*>(this)->Find(key); }
+
+    bool Erase(const Key& key)
+    {
+        Slot* slot = FindSlot(key, HashOf(key));
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        const std::size_t index = static_cast<std::size_t>(slot - m_Slots);
+        //A probe only moves past a group without an empty byte, so in a group that has one the slot can be
+        //emptied instead of leaving a tombstone
+        const std::size_t groupStart = index & ~(groupWidth - 1);
+        if (flat_hash_map_detail::Group(m_Control + groupStart).MatchEmpty() != 0)
+        {
+            m_Control[index] = flat_hash_map_detail::empty;
+        }
+        else
+        {
+            m_Control[index] = flat_hash_map_detail::deleted;
+            m_Deleted++;
+        }
+        m_Size--;
+        return true;
+    }
+
+    //results[i] is the value of keys[i] or nullptr. A batch of lookups goes through each stage before the next
+    //stage starts: hash and prefetch the control group, match H2 and prefetch the first candidate slot, probe.
+    //The cache misses of the batch overlap instead of queuing one after the other.
+    void FindBatch(std::span<const Key> keys, std::span<const Value*> results) const
+    {
+        using namespace flat_hash_map_detail;
+        std::uint64_t hashes[batchSize];
+        for (std::size_t begin = 0; begin < keys.size(); begin += batchSize)
+        {
+            const std::size_t count = std::min(batchSize, keys.size() - begin);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                hashes[i] = HashOf(keys[begin + i]);
+                _mm_prefetch(reinterpret_cast<const char*>(m_Control + GroupStart(hashes[i])), _MM_HINT_T0);
+            }
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const std::size_t group = GroupStart(hashes[i]);
+                const auto match = Group(m_Control + group).Match(H2(hashes[i]));
+                if (match != 0)
+                {
+                    _mm_prefetch(reinterpret_cast<const char*>(&m_Slots[group + std::countr_zero(match)]), _MM_HINT_T0);
+                }
+            }
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const Slot* slot = const_cast<FlatHashMap*>(this)->FindSlot(keys[begin + i], hashes[i]);
+                results[begin + i] = slot != nullptr ? &slot->value : nullptr;
+            }
+        }
+    }
+
+    template<typename F>
+    void ForEach(F&& f) const
+    {
+        for (std::size_t i = 0; i < m_Capacity; i++)
+        {
+            if (m_Control[i] >= 0)
+            {
+                f(m_Slots[i].key, m_Slots[i].value);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        Key key;
+        Value value;
+    };
+
+    std::uint64_t HashOf(const Key& key) const
+    {
+        return flat_hash_map_detail::Mix(static_cast<std::uint64_t>(Hash{}(key)));
+    }
+    static std::int8_t H2(std::uint64_t hash) { return static_cast<std::int8_t>(hash & 0x7F); }
+    //H1 picks the first group, from the high bits so that it does not overlap H2
+    std::size_t GroupStart(std::uint64_t hash) const
+    {
+        return static_cast<std::size_t>(hash >> 7) & (m_Capacity - 1) & ~(groupWidth - 1);
+    }
+
+    Slot* FindSlot(const Key& key, std::uint64_t hash)
+    {
+        using namespace flat_hash_map_detail;
+        const std::int8_t h2 = H2(hash);
+        std::size_t group = GroupStart(hash);
+        for (std::size_t step = groupWidth;; step += groupWidth)
+        {
+            const Group controls(m_Control + group);
+            for (auto match = controls.Match(h2); match != 0; match &= match - 1)
+            {
+                Slot& slot = m_Slots[group + std::countr_zero(match)];
+                if (slot.key == key)
+                {
+                    return &slot;
+                }
+            }
+            if (controls.MatchEmpty() != 0)
+            {
+                return nullptr;
+            }
+            group = (group + step) & (m_Capacity - 1);
+        }
+    }
+
+    //The key must not be present and there must be room
+    void InsertNew(const Key& key, const Value& value, std::uint64_t hash)
+    {
+        using namespace flat_hash_map_detail;
+        std::size_t group = GroupStart(hash);
+        for (std::size_t step = groupWidth;; step += groupWidth)
+        {
+            const auto free = Group(m_Control + group).MatchEmptyOrDeleted();
+            if (free != 0)
+            {
+                const std::size_t index = group + std::countr_zero(free);
+                if (m_Control[index] == deleted)
+                {
+                    m_Deleted--;
+                }
+                m_Control[index] = H2(hash);
+                m_Slots[index] = {key, value};
+                m_Size++;
+                return;
+            }
+            group = (group + step) & (m_Capacity - 1);
+        }
+    }
+
+    //Also drops the tombstones when called with the current capacity
+    void Rehash(std::size_t capacity)
+    {
+        using namespace flat_hash_map_detail;
+        auto oldMemory = std::move(m_Memory);
+        const std::int8_t* oldControl = m_Control;
+        const Slot* oldSlots = m_Slots;
+        const std::size_t oldCapacity = m_Capacity;
+
+        //Control bytes then slots in one block, the slots start at a multiple of the group width
+        const std::size_t bytes = (capacity * (1 + sizeof(Slot)) + 63) / 64 * 64;
+        m_Memory.reset(static_cast<std::byte*>(std::aligned_alloc(64, bytes)));
+        m_Capacity = capacity;
+        m_Control = reinterpret_cast<std::int8_t*>(m_Memory.get());
+        m_Slots = reinterpret_cast<Slot*>(m_Memory.get() + capacity);
+        std::fill_n(m_Control, capacity, empty);
+        m_Size = 0;
+        m_Deleted = 0;
+        for (std::size_t i = 0; i < oldCapacity; i++)
+        {
+            if (oldControl[i] >= 0)
+            {
+                InsertNew(oldSlots[i].key, oldSlots[i].value, HashOf(oldSlots[i].key));
+            }
+        }
+    }
+
+    std::unique_ptr<std::byte[], flat_hash_map_detail::AlignedFree> m_Memory;
+    std::int8_t* m_Control = nullptr;
+    Slot* m_Slots = nullptr;
+    std::size_t m_Capacity = 0;
+    std::size_t m_Size = 0;
+    std::size_t m_Deleted = 0;
+};
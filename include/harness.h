@@ -0,0 +1,596 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "sweep.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+//Noise-controlled execution, enabled with --harness (or BENCH_HARNESS=1) on any bench target:
+//  --harness_cpus=2,4-5      pin the process (and the benchmark threads it spawns) to these cores,
+//                            default BENCH_HARNESS_CPUS
+//  --harness_warmup_ms=2000  spin until back to back timings converge, at most this long
+//  --harness_max_cv=0.03     re-run benchmarks whose repetitions vary more than this
+//  --harness_reruns=3        maximum number of re-runs of an unstable benchmark
+//Benchmarks run with 5 repetitions unless --benchmark_repetitions is given. Runs during which the
+//frequency or governor of the pinned cores (every allowed core when unpinned) changed are re-run
+//too. --benchmark_out only receives the most stable attempt of each benchmark, the console shows
+//every attempt.
+struct HarnessOptions
+{
+    bool enabled = false;
+    std::vector<int> cpus;
+    int warmupMs = 2000;
+    double maxCv = 0.03;
+    int reruns = 3;
+    std::string format = "console";
+    std::string outPath;
+    std::string outFormat = "json";
+};
+
+namespace harness_detail
+{
+constexpr int defaultRepetitions = 5;
+constexpr double frequencyTolerance = 0.05;
+
+//"2,4-6" -> {2, 4, 5, 6}
+inline std::vector<int> ParseCpuList(const char* text)
+{
+    std::vector<int> cpus;
+    while (*text != '\0')
+    {
+        char* end = nullptr;
+        const long first = std::strtol(text, &end, 10);
+        if (end == text)
+        {
+            break;
+        }
+        long last = first;
+        text = end;
+        if (*text == '-')
+        {
+            last = std::strtol(text + 1, &end, 10);
+            text = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*text == ',')
+        {
+            text++;
+        }
+    }
+    return cpus;
+}
+
+inline bool PinToCpus(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+//The cores the process may run on, where the benchmarks land when --harness_cpus is not given
+inline std::vector<int> AffinityCpus()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+inline std::string ReadCpuFreqFile(int cpu, const char* name)
+{
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/" + name);
+    std::string value;
+    file >> value;
+    return value;
+}
+
+struct FrequencySample
+{
+    double mhz = 0.0;
+    std::string governor;
+};
+
+//Empty when the kernel exposes no cpufreq information (VMs, non-Linux)
+inline std::vector<FrequencySample> SampleFrequencies(const std::vector<int>& cpus)
+{
+    std::vector<FrequencySample> samples;
+    for (const int cpu : cpus)
+    {
+        const std::string khz = ReadCpuFreqFile(cpu, "scaling_cur_freq");
+        if (khz.empty())
+        {
+            return {};
+        }
+        samples.push_back({std::atof(khz.c_str()) / 1000.0, ReadCpuFreqFile(cpu, "scaling_governor")});
+    }
+    return samples;
+}
+
+inline double CoefficientOfVariation(const std::vector<double>& values)
+{
+    if (values.size() < 2)
+    {
+        return 0.0;
+    }
+    double mean = 0.0;
+    for (const double value : values)
+    {
+        mean += value;
+    }
+    mean /= static_cast<double>(values.size());
+    double variance = 0.0;
+    for (const double value : values)
+    {
+        variance += (value - mean) * (value - mean);
+    }
+    variance /= static_cast<double>(values.size() - 1);
+    return mean > 0.0 ? std::sqrt(variance) / mean : 0.0;
+}
+
+//Runs a fixed dependent integer chain until the last chunk timings agree within 1%, so turbo and
+//the governor have ramped up before the first measurement
+inline void WarmUp(int maxMs)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr std::size_t window = 5;
+    const auto deadline = Clock::now() + std::chrono::milliseconds(maxMs);
+    std::vector<double> chunks;
+    std::uint64_t value = 1;
+    double cv = 1.0;
+    while (Clock::now() < deadline)
+    {
+        const auto start = Clock::now();
+        for (int i = 0; i < 1 << 20; i++)
+        {
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+            benchmark::DoNotOptimize(value);
+        }
+        chunks.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        if (chunks.size() >= window)
+        {
+            cv = CoefficientOfVariation(std::vector<double>(chunks.end() - window, chunks.end()));
+            if (cv < 0.01)
+            {
+                break;
+            }
+        }
+    }
+    std::fprintf(stderr, "harness: warm-up %s after %zu chunks (cv %.2f%%)\n", cv < 0.01 ? "converged" : "timed out",
+                 chunks.size(), cv * 100.0);
+}
+
+//Escapes a benchmark name for the POSIX extended regex of --benchmark_filter
+inline std::string EscapeName(const std::string& name)
+{
+    std::string escaped;
+    for (const char c : name)
+    {
+        if (std::strchr(".[]{}()*+?^$|\\", c) != nullptr)
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+inline std::unique_ptr<benchmark::BenchmarkReporter> CreateReporter(const std::string& format)
+{
+    if (format == "json")
+    {
+        return std::make_unique<benchmark::JSONReporter>();
+    }
+    if (format == "csv")
+    {
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+        return std::make_unique<benchmark::CSVReporter>();
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+    }
+#if defined(__linux__)
+    const bool color = isatty(fileno(stdout)) != 0;
+#else
+    const bool color = false;
+#endif
+    return std::make_unique<benchmark::ConsoleReporter>(
+        color ? benchmark::ConsoleReporter::OO_ColorTabular : benchmark::ConsoleReporter::OO_Tabular);
+}
+
+//Forwards every attempt to the display reporter and keeps the most stable attempt per benchmark
+class HarnessReporter : public benchmark::BenchmarkReporter
+{
+public:
+    HarnessReporter(benchmark::BenchmarkReporter& display, const HarnessOptions& options)
+        : m_Display(display), m_Options(options), m_Cpus(options.cpus.empty() ? AffinityCpus() : options.cpus)
+    {
+    }
+
+    bool ReportContext(const Context& context) override
+    {
+        m_LastSample = SampleFrequencies(m_Cpus);
+        if (m_ContextReported)
+        {
+            return true;
+        }
+        m_ContextReported = true;
+        for (std::size_t i = 0; i < m_LastSample.size(); i++)
+        {
+            if (m_LastSample[i].governor != "performance")
+            {
+                std::fprintf(stderr, "harness: cpu %d uses the '%s' governor, frequency may drift\n",
+                             m_Cpus[i], m_LastSample[i].governor.c_str());
+            }
+        }
+        return m_Display.ReportContext(context);
+    }
+
+    void ReportRuns(const std::vector<Run>& reports) override
+    {
+        if (reports.empty())
+        {
+            return;
+        }
+        const std::string name = reports.front().run_name.str();
+        //Aggregates of the repetitions come in a second call, they follow their iteration runs
+        if (reports.front().run_type == Run::RT_Aggregate && name == m_LastIterationName)
+        {
+            if (m_Kept != nullptr)
+            {
+                m_Kept->runs.insert(m_Kept->runs.end(), reports.begin(), reports.end());
+            }
+            m_Display.ReportRuns(reports);
+            return;
+        }
+        std::vector<Run> runs = reports;
+        double mhz = 0.0;
+        const bool drifted = SampleDrift(mhz);
+
+        std::vector<double> times;
+        double aggregateCv = -1.0;
+        bool failed = false;
+        for (auto& run : runs)
+        {
+            failed |= run.error_occurred;
+            if (run.run_type == Run::RT_Iteration && !run.error_occurred)
+            {
+                times.push_back(run.GetAdjustedRealTime());
+            }
+            //ReportAggregatesOnly benchmarks only send the aggregates, the cv one holds the ratio itself
+            if (run.run_type == Run::RT_Aggregate && run.aggregate_name == "cv")
+            {
+                aggregateCv = run.real_accumulated_time;
+            }
+            if (!m_LastSample.empty())
+            {
+                run.counters["cpu_mhz"] = mhz;
+            }
+        }
+        const double cv = times.empty() && aggregateCv >= 0.0 ? aggregateCv : CoefficientOfVariation(times);
+        m_LastIterationName = runs.front().run_type == Run::RT_Iteration ? name : std::string();
+
+        auto it = m_Results.find(name);
+        if (it == m_Results.end())
+        {
+            m_Order.push_back(name);
+            it = m_Results.emplace(name, Result{}).first;
+        }
+        else if (it->second.cv <= cv && !it->second.drifted)
+        {
+            m_Kept = nullptr;
+            m_Display.ReportRuns(runs);
+            return;
+        }
+        it->second = {runs, cv, drifted, failed};
+        m_Kept = &it->second;
+        m_Display.ReportRuns(runs);
+    }
+
+    //Benchmarks still above the CV threshold or measured across a frequency change
+    [[nodiscard]] std::vector<std::string> Unstable() const
+    {
+        std::vector<std::string> names;
+        for (const auto& name : m_Order)
+        {
+            const auto& result = m_Results.at(name);
+            if (!result.failed && (result.cv > m_Options.maxCv || result.drifted))
+            {
+                names.push_back(name);
+            }
+        }
+        return names;
+    }
+
+    [[nodiscard]] double Cv(const std::string& name) const { return m_Results.at(name).cv; }
+
+    void Finish()
+    {
+        m_Display.Finalize();
+        if (m_Options.outPath.empty())
+        {
+            return;
+        }
+        std::ofstream file(m_Options.outPath);
+        if (!file)
+        {
+            std::fprintf(stderr, "harness: cannot open %s\n", m_Options.outPath.c_str());
+            return;
+        }
+        auto reporter = CreateReporter(m_Options.outFormat);
+        reporter->SetOutputStream(&file);
+        reporter->SetErrorStream(&std::cerr);
+        Context context;
+        reporter->ReportContext(context);
+        for (const auto& name : m_Order)
+        {
+            reporter->ReportRuns(m_Results.at(name).runs);
+        }
+        reporter->Finalize();
+    }
+
+private:
+    //Samples the frequencies again, true when they moved since the previous sample. mhz is their mean.
+    bool SampleDrift(double& mhz)
+    {
+        const auto sample = SampleFrequencies(m_Cpus);
+        bool drifted = false;
+        mhz = 0.0;
+        for (std::size_t i = 0; i < sample.size() && i < m_LastSample.size(); i++)
+        {
+            drifted |= sample[i].governor != m_LastSample[i].governor ||
+                       std::abs(sample[i].mhz - m_LastSample[i].mhz) > frequencyTolerance * m_LastSample[i].mhz;
+            mhz += sample[i].mhz / static_cast<double>(sample.size());
+        }
+        m_LastSample = sample;
+        return drifted;
+    }
+
+    struct Result
+    {
+        std::vector<Run> runs;
+        double cv = 0.0;
+        bool drifted = false;
+        bool failed = false;
+    };
+
+    benchmark::BenchmarkReporter& m_Display;
+    const HarnessOptions& m_Options;
+    //Sampled for frequency and governor changes
+    std::vector<int> m_Cpus;
+    bool m_ContextReported = false;
+    std::vector<FrequencySample> m_LastSample;
+    std::vector<std::string> m_Order;
+    std::map<std::string, Result> m_Results;
+    Result* m_Kept = nullptr;
+    //Run name of the last iteration runs, their aggregates attach to them
+    std::string m_LastIterationName;
+};
+
+//Text after the flag prefix, nullptr when the argument is another flag
+inline const char* FlagValue(const char* argument, const char* flag)
+{
+    const std::size_t length = std::strlen(flag);
+    return std::strncmp(argument, flag, length) == 0 ? argument + length : nullptr;
+}
+
+inline std::vector<std::string>& ArgumentStorage()
+{
+    static std::vector<std::string> storage;
+    return storage;
+}
+}
+
+//Strips the harness flags, call it before benchmark::Initialize. In harness mode argv is rewritten
+//to add the default repetitions and to take over --benchmark_format and --benchmark_out.
+inline HarnessOptions ParseHarnessFlags(int& argc, char**& argv)
+{
+    using namespace harness_detail;
+    HarnessOptions options;
+    if (const char* env = std::getenv("BENCH_HARNESS"))
+    {
+        options.enabled = std::strcmp(env, "0") != 0;
+    }
+    if (const char* env = std::getenv("BENCH_HARNESS_CPUS"))
+    {
+        options.cpus = ParseCpuList(env);
+    }
+
+    std::vector<std::string> kept;
+    std::vector<const char*> deferred;
+    bool repetitions = false;
+    for (int i = 0; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        const char* value = nullptr;
+        if (std::strcmp(argument, "--harness") == 0)
+        {
+            options.enabled = true;
+        }
+        else if ((value = FlagValue(argument, "--harness_cpus=")))
+        {
+            options.enabled = true;
+            options.cpus = ParseCpuList(value);
+        }
+        else if ((value = FlagValue(argument, "--harness_warmup_ms=")))
+        {
+            options.enabled = true;
+            options.warmupMs = std::atoi(value);
+        }
+        else if ((value = FlagValue(argument, "--harness_max_cv=")))
+        {
+            options.enabled = true;
+            options.maxCv = std::atof(value);
+        }
+        else if ((value = FlagValue(argument, "--harness_reruns=")))
+        {
+            options.enabled = true;
+            options.reruns = std::atoi(value);
+        }
+        else if (i > 0 && (FlagValue(argument, "--benchmark_format=") || FlagValue(argument, "--benchmark_out=") ||
+                           FlagValue(argument, "--benchmark_out_format=")))
+        {
+            deferred.push_back(argument);
+        }
+        else
+        {
+            repetitions |= FlagValue(argument, "--benchmark_repetitions=") != nullptr;
+            kept.emplace_back(argument);
+        }
+    }
+
+    for (const char* argument : deferred)
+    {
+        const char* value = nullptr;
+        if (!options.enabled)
+        {
+            kept.emplace_back(argument);
+        }
+        else if ((value = FlagValue(argument, "--benchmark_format=")))
+        {
+            options.format = value;
+        }
+        else if ((value = FlagValue(argument, "--benchmark_out=")))
+        {
+            options.outPath = value;
+        }
+        else if ((value = FlagValue(argument, "--benchmark_out_format=")))
+        {
+            options.outFormat = value;
+        }
+    }
+    if (options.enabled && !repetitions)
+    {
+        kept.push_back("--benchmark_repetitions=" + std::to_string(defaultRepetitions));
+    }
+
+    auto& storage = ArgumentStorage();
+    storage = std::move(kept);
+    static std::vector<char*> pointers;
+    pointers.clear();
+    for (auto& argument : storage)
+    {
+        pointers.push_back(argument.data());
+    }
+    pointers.push_back(nullptr);
+    argc = static_cast<int>(storage.size());
+    argv = pointers.data();
+    return options;
+}
+
+//Drop-in for benchmark::RunSpecifiedBenchmarks, plain run when the harness is disabled
+inline std::size_t RunHarnessedBenchmarks(const HarnessOptions& options,
+                                          benchmark::BenchmarkReporter* display = nullptr)
+{
+    using namespace harness_detail;
+    if (!options.enabled)
+    {
+        return display == nullptr ? benchmark::RunSpecifiedBenchmarks() : benchmark::RunSpecifiedBenchmarks(display);
+    }
+    if (!options.cpus.empty() && !PinToCpus(options.cpus))
+    {
+        std::fprintf(stderr, "harness: sched_setaffinity failed, running unpinned\n");
+    }
+    if (options.warmupMs > 0)
+    {
+        WarmUp(options.warmupMs);
+    }
+
+    std::unique_ptr<benchmark::BenchmarkReporter> defaultDisplay;
+    if (display == nullptr)
+    {
+        defaultDisplay = CreateReporter(options.format);
+        display = defaultDisplay.get();
+    }
+    HarnessReporter reporter(*display, options);
+    const std::size_t count = benchmark::RunSpecifiedBenchmarks(&reporter);
+    for (int attempt = 1; attempt <= options.reruns; attempt++)
+    {
+        const auto unstable = reporter.Unstable();
+        if (unstable.empty())
+        {
+            break;
+        }
+        std::string filter;
+        for (const auto& name : unstable)
+        {
+            std::fprintf(stderr, "harness: re-running %s (cv %.2f%%), attempt %d/%d\n", name.c_str(),
+                         reporter.Cv(name) * 100.0, attempt, options.reruns);
+            filter += filter.empty() ? "^(" : "|";
+            filter += EscapeName(name);
+        }
+        benchmark::RunSpecifiedBenchmarks(&reporter, filter + ")$");
+    }
+    for (const auto& name : reporter.Unstable())
+    {
+        std::fprintf(stderr, "harness: %s is still unstable (cv %.2f%%)\n", name.c_str(), reporter.Cv(name) * 100.0);
+    }
+    reporter.Finish();
+    return count;
+}
+
+//Replaces BENCHMARK_MAIN() for targets without a custom main. The driver links every suite and
+//defines BENCH_DRIVER so only its own main remains.
+#ifdef BENCH_DRIVER
+#define BENCH_HARNESS_MAIN() static_assert(true)
+#else
+#define BENCH_HARNESS_MAIN()                                                \
+    int main(int argc, char** argv)                                         \
+    {                                                                       \
+        const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv); \
+        if (!ConfigureSweeps(argc, argv))                                   \
+        {                                                                   \
+            return 1;                                                       \
+        }                                                                   \
+        benchmark::Initialize(&argc, argv);                                 \
+        if (benchmark::ReportUnrecognizedArguments(argc, argv))             \
+        {                                                                   \
+            return 1;                                                       \
+        }                                                                   \
+        RunHarnessedBenchmarks(harnessOptions);                             \
+        benchmark::Shutdown();                                              \
+        return 0;                                                           \
+    }                                                                       \
+    int main(int, char**)
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <benchmark/benchmark.h>
+#include "cycle_clock.h"
+
+//HDR-style histogram of cycle counts: values below 2^subBucketBits are exact, above that each
+//power of two is split in 2^subBucketBits linear sub-buckets (~3% relative precision).
+//All storage is inline, recording never allocates.
+class LatencyHistogram
+{
+public:
+    static constexpr int subBucketBits = 5;
+    static constexpr std::uint64_t subBucketCount = 1u << subBucketBits;
+    static constexpr std::size_t bucketCount = subBucketCount * (64 - subBucketBits + 1);
+
+    void Record(std::uint64_t value)
+    {
+        m_Counts[Index(value)]++;
+        m_Total++;
+        m_Max = value > m_Max ? value : m_Max;
+        m_Min = value < m_Min ? value : m_Min;
+    }
+
+    void Reset()
+    {
+        m_Counts.fill(0);
+        m_Total = 0;
+        m_Max = 0;
+        m_Min = ~std::uint64_t{0};
+    }
+
+    [[nodiscard]] std::uint64_t Count() const { return m_Total; }
+    [[nodiscard]] std::uint64_t Max() const { return m_Max; }
+    [[nodiscard]] std::uint64_t Min() const { return m_Total == 0 ? 0 : m_Min; }
+
+    //Highest value of the bucket holding the requested percentile (0-100)
+    [[nodiscard]] std::uint64_t Percentile(double percentile) const
+    {
+        if (m_Total == 0)
+        {
+            return 0;
+        }
+        const auto target = static_cast<std::uint64_t>(static_cast<double>(m_Total) * percentile / 100.0 + 0.5);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucketCount; i++)
+        {
+            seen += m_Counts[i];
+            if (seen >= target && m_Counts[i] != 0)
+            {
+                return std::min(UpperBound(i), m_Max);
+            }
+        }
+        return m_Max;
+    }
+
+    //One "lower upper count cumulative_percent" line per non-empty bucket
+    void Dump(std::ostream& os) const
+    {
+        std::uint64_t seen = 0;
+        os << "# lower upper count percentile\n";
+        for (std::size_t i = 0; i < bucketCount; i++)
+        {
+            if (m_Counts[i] == 0)
+            {
+                continue;
+            }
+            seen += m_Counts[i];
+            os << LowerBound(i) << ' ' << UpperBound(i) << ' ' << m_Counts[i] << ' '
+               << 100.0 * static_cast<double>(seen) / static_cast<double>(m_Total) << '\n';
+        }
+    }
+
+private:
+    static std::size_t Index(std::uint64_t value)
+    {
+        if (value < subBucketCount)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        const int exponent = std::bit_width(value) - 1;
+        const int shift = exponent - subBucketBits;
+        const std::uint64_t mantissa = (value >> shift) - subBucketCount;
+        return static_cast<std::size_t>(subBucketCount + static_cast<std::uint64_t>(shift) * subBucketCount + mantissa);
+    }
+
+    static std::uint64_t LowerBound(std::size_t index)
+    {
+        if (index < subBucketCount)
+        {
+            return index;
+        }
+        const std::uint64_t shift = (index - subBucketCount) / subBucketCount;
+        const std::uint64_t mantissa = (index - subBucketCount) % subBucketCount;
+        return (subBucketCount + mantissa) << shift;
+    }
+
+    static std::uint64_t UpperBound(std::size_t index)
+    {
+        if (index < subBucketCount)
+        {
+            return index;
+        }
+        const std::uint64_t shift = (index - subBucketCount) / subBucketCount;
+        return LowerBound(index) + (std::uint64_t{1} << shift) - 1;
+    }
+
+    std::array<std::uint64_t, bucketCount> m_Counts{};
+    std::uint64_t m_Total = 0;
+    std::uint64_t m_Max = 0;
+    std::uint64_t m_Min = ~std::uint64_t{0};
+};
+
+//Records the cycles spent in its scope, place it inside the benchmark loop
+class LatencyScope
+{
+public:
+    explicit LatencyScope(LatencyHistogram& histogram) : m_Histogram(histogram), m_Start(ReadCycles()) {}
+    ~LatencyScope() { m_Histogram.Record(ReadCycles() - m_Start); }
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+private:
+    LatencyHistogram& m_Histogram;
+    std::uint64_t m_Start;
+};
+
+//Publishes p50/p90/p99/p99.9/max in cycles as counters. When BENCH_LATENCY_DUMP_DIR is set the
+//full histogram is also written to <dir>/<name>.hgrm
+inline void PublishLatencyHistogram(benchmark::State& state, const LatencyHistogram& histogram, const std::string& name)
+{
+    state.counters["p50_cyc"] = static_cast<double>(histogram.Percentile(50.0));
+    state.counters["p90_cyc"] = static_cast<double>(histogram.Percentile(90.0));
+    state.counters["p99_cyc"] = static_cast<double>(histogram.Percentile(99.0));
+    state.counters["p99.9_cyc"] = static_cast<double>(histogram.Percentile(99.9));
+    state.counters["max_cyc"] = static_cast<double>(histogram.Max());
+
+    if (const char* dir = std::getenv("BENCH_LATENCY_DUMP_DIR"))
+    {
+        std::ofstream file(std::string(dir) + "/" + name + ".hgrm");
+        histogram.Dump(file);
+    }
+}
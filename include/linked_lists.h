@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+//Linked containers with the subset of the std::list interface the transform systems use (begin, end, size,
+//insert before an iterator, erase), so they swap in for std::vector and std::list as a container policy.
+//ForEachElement and IteratorAt are the traversal and positioning the systems go through, the overloads of
+//UnrolledList work a node at a time instead of an element at a time.
+
+//Doubly linked list whose nodes live in one growing array and link by index. Freed nodes go to a free list
+//and are reused first, so the nodes stay in one contiguous block however the list is edited, but the link
+//order drifts away from the address order.
+template<typename T>
+class PoolList
+{
+    struct Node
+    {
+        T value;
+        std::uint32_t prev;
+        std::uint32_t next;
+    };
+    //Node 0 is the sentinel: its next is the front and its prev the back
+    static constexpr std::uint32_t sentinel = 0;
+
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() = default;
+        Iterator(Node* nodes, std::uint32_t index) : m_Nodes(nodes), m_Index(index) {}
+
+        T& operator*() const { return m_Nodes[m_Index].value; }
+        T* operator->() const { return &m_Nodes[m_Index].value; }
+        Iterator& operator++()
+        {
+            m_Index = m_Nodes[m_Index].next;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+        Iterator& operator--()
+        {
+            m_Index = m_Nodes[m_Index].prev;
+            return *this;
+        }
+        Iterator operator--(int)
+        {
+            auto previous = *this;
+            --*this;
+            return previous;
+        }
+        bool operator==(const Iterator& other) const { return m_Index == other.m_Index; }
+
+    private:
+        friend class PoolList;
+        Node* m_Nodes = nullptr;
+        std::uint32_t m_Index = sentinel;
+    };
+    using iterator = Iterator;
+    using value_type = T;
+
+    PoolList() : m_Nodes(1) { m_Nodes[sentinel].prev = m_Nodes[sentinel].next = sentinel; }
+
+    [[nodiscard]] std::size_t size() const { return m_Size; }
+    iterator begin() { return {m_Nodes.data(), m_Nodes[sentinel].next}; }
+    iterator end() { return {m_Nodes.data(), sentinel}; }
+
+    iterator insert(iterator position, const T& value)
+    {
+        const std::uint32_t next = position.m_Index;
+        std::uint32_t index = m_FreeHead;
+        if (index != sentinel)
+        {
+            m_FreeHead = m_Nodes[index].next;
+        }
+        else
+        {
+            //Growing moves the nodes, links are indices so only the iterators go stale
+            index = static_cast<std::uint32_t>(m_Nodes.size());
+            m_Nodes.emplace_back();
+        }
+        const std::uint32_t prev = m_Nodes[next].prev;
+        m_Nodes[index] = {value, prev, next};
+        m_Nodes[prev].next = index;
+        m_Nodes[next].prev = index;
+        m_Size++;
+        return {m_Nodes.data(), index};
+    }
+
+    iterator erase(iterator position)
+    {
+        const std::uint32_t index = position.m_Index;
+        const Node& node = m_Nodes[index];
+        const std::uint32_t next = node.next;
+        m_Nodes[node.prev].next = next;
+        m_Nodes[next].prev = node.prev;
+        m_Nodes[index].next = m_FreeHead;
+        m_FreeHead = index;
+        m_Size--;
+        return {m_Nodes.data(), next};
+    }
+
+private:
+    std::vector<Node> m_Nodes;
+    //Singly linked through next, sentinel when empty
+    std::uint32_t m_FreeHead = sentinel;
+    std::size_t m_Size = 0;
+};
+
+//Doubly linked list of NodeBytes nodes, each holding as many elements as fit after the links and the count,
+//in order. A full node splits in two halves on insert and a node is freed when its last element is erased.
+template<typename T, std::size_t NodeBytes = 64>
+class UnrolledList
+{
+    struct NodeHeader
+    {
+        void* prev;
+        void* next;
+        std::uint32_t count;
+    };
+
+public:
+    static constexpr std::size_t nodeCapacity =
+        NodeBytes > sizeof(NodeHeader) + sizeof(T) ? (NodeBytes - sizeof(NodeHeader)) / sizeof(T) : 1;
+
+    struct alignas(64) Node
+    {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        std::uint32_t count = 0;
+        T items[nodeCapacity];
+    };
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() = default;
+        Iterator(Node* node, std::uint32_t index) : m_Node(node), m_Index(index) {}
+
+        T& operator*() const { return m_Node->items[m_Index]; }
+        T* operator->() const { return &m_Node->items[m_Index]; }
+        Iterator& operator++()
+        {
+            if (++m_Index == m_Node->count)
+            {
+                m_Node = m_Node->next;
+                m_Index = 0;
+            }
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const Iterator& other) const = default;
+
+    private:
+        friend class UnrolledList;
+        Node* m_Node = nullptr;
+        std::uint32_t m_Index = 0;
+    };
+    using iterator = Iterator;
+    using value_type = T;
+
+    UnrolledList() = default;
+    ~UnrolledList()
+    {
+        while (m_Head != nullptr)
+        {
+            delete std::exchange(m_Head, m_Head->next);
+        }
+    }
+    UnrolledList(const UnrolledList&) = delete;
+    UnrolledList& operator=(const UnrolledList&) = delete;
+
+    [[nodiscard]] std::size_t size() const { return m_Size; }
+    iterator begin() { return {m_Head, 0}; }
+    iterator end() { return {}; }
+    [[nodiscard]] Node* Front() const { return m_Head; }
+
+    iterator insert(iterator position, const T& value)
+    {
+        Node* node = position.m_Node;
+        std::uint32_t index = position.m_Index;
+        if (node == nullptr)
+        {
+            //Before end: append to the back node
+            if (m_Tail == nullptr || m_Tail->count == nodeCapacity)
+            {
+                LinkAfter(m_Tail, new Node);
+            }
+            node = m_Tail;
+            index = node->count;
+        }
+        if (node->count == nodeCapacity)
+        {
+            Node* upper = new Node;
+            LinkAfter(node, upper);
+            const std::uint32_t half = node->count / 2;
+            std::copy(node->items + half, node->items + node->count, upper->items);
+            upper->count = node->count - half;
+            node->count = half;
+            if (index > half)
+            {
+                node = upper;
+                index -= half;
+            }
+        }
+        std::copy_backward(node->items + index, node->items + node->count, node->items + node->count + 1);
+        node->items[index] = value;
+        node->count++;
+        m_Size++;
+        return {node, index};
+    }
+
+    iterator erase(iterator position)
+    {
+        Node* node = position.m_Node;
+        const std::uint32_t index = position.m_Index;
+        std::copy(node->items + index + 1, node->items + node->count, node->items + index);
+        node->count--;
+        m_Size--;
+        if (node->count == 0)
+        {
+            Node* next = node->next;
+            Unlink(node);
+            delete node;
+            return {next, 0};
+        }
+        return index == node->count ? iterator{node->next, 0} : iterator{node, index};
+    }
+
+    //Skips whole nodes
+    iterator IteratorAt(std::size_t index)
+    {
+        Node* node = m_Head;
+        while (node != nullptr && index >= node->count)
+        {
+            index -= node->count;
+            node = node->next;
+        }
+        return {node, static_cast<std::uint32_t>(index)};
+    }
+
+private:
+    //After nullptr is at the front
+    void LinkAfter(Node* prev, Node* node)
+    {
+        Node* next = prev != nullptr ? prev->next : m_Head;
+        node->prev = prev;
+        node->next = next;
+        (prev != nullptr ? prev->next : m_Head) = node;
+        (next != nullptr ? next->prev : m_Tail) = node;
+    }
+    void Unlink(Node* node)
+    {
+        (node->prev != nullptr ? node->prev->next : m_Head) = node->next;
+        (node->next != nullptr ? node->next->prev : m_Tail) = node->prev;
+    }
+
+    Node* m_Head = nullptr;
+    Node* m_Tail = nullptr;
+    std::size_t m_Size = 0;
+};
+
+template<typename Container, typename F>
+inline void ForEachElement(Container& container, F&& f)
+{
+    for (auto& element : container)
+    {
+        f(element);
+    }
+}
+
+template<typename T, std::size_t NodeBytes, typename F>
+inline void ForEachElement(UnrolledList<T, NodeBytes>& list, F&& f)
+{
+    for (auto* node = list.Front(); node != nullptr; node = node->next)
+    {
+        for (std::uint32_t i = 0; i < node->count; i++)
+        {
+            f(node->items[i]);
+        }
+    }
+}
+
+//Random access for std::vector, a walk for the lists
+template<typename Container>
+inline auto IteratorAt(Container& container, std::size_t index)
+{
+    return std::next(container.begin(), static_cast<std::ptrdiff_t>(index));
+}
+
+template<typename T, std::size_t NodeBytes>
+inline auto IteratorAt(UnrolledList<T, NodeBytes>& list, std::size_t index)
+{
+    return list.IteratorAt(index);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum class PerfEvent
+{
+    Cycles,
+    Instructions,
+    L1DReadMiss,
+    LLCReadMiss,
+    DTLBReadAccess,
+    DTLBReadMiss,
+};
+
+//Hardware counter for the calling thread, invalid when perf_event_open is unavailable or not permitted
+class PerfCounter
+{
+public:
+    explicit PerfCounter(PerfEvent event)
+    {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        switch (event)
+        {
+        case PerfEvent::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::L1DReadMiss:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case PerfEvent::LLCReadMiss:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        case PerfEvent::DTLBReadAccess:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+            break;
+        case PerfEvent::DTLBReadMiss:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS);
+            break;
+        }
+        m_Fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)event;
+#endif
+    }
+    ~PerfCounter()
+    {
+#if defined(__linux__)
+        if (m_Fd >= 0)
+        {
+            close(m_Fd);
+        }
+#endif
+    }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    [[nodiscard]] bool IsValid() const { return m_Fd >= 0; }
+
+    void Start()
+    {
+#if defined(__linux__)
+        if (m_Fd >= 0)
+        {
+            ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    void Stop()
+    {
+#if defined(__linux__)
+        if (m_Fd >= 0)
+        {
+            ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+    [[nodiscard]] std::uint64_t Read() const
+    {
+        std::uint64_t value = 0;
+#if defined(__linux__)
+        if (m_Fd >= 0 && read(m_Fd, &value, sizeof(value)) != sizeof(value))
+        {
+            value = 0;
+        }
+#endif
+        return value;
+    }
+
+private:
+#if defined(__linux__)
+    static std::uint64_t CacheConfig(std::uint64_t cache, std::uint64_t result)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    }
+#endif
+    int m_Fd = -1;
+};
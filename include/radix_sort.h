@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+#include "task_graph.h"
+
+//LSD radix sort of 32-bit keys carrying a payload, 8-bit digits. Stable, passes whose digit is the
+//same for every key are skipped. The scratch spans must be as large as the input, the result always
+//ends up in keys/payloads. RadixPartition is the single pass version for keys below 256.
+namespace radix_sort_detail
+{
+constexpr int digitBits = 8;
+constexpr std::size_t buckets = 1u << digitBits;
+constexpr int passes = 32 / digitBits;
+
+using Histogram = std::array<std::uint32_t, buckets>;
+
+inline std::uint32_t Digit(std::uint32_t key, int pass)
+{
+    return (key >> (pass * digitBits)) & (buckets - 1);
+}
+
+//Returns true when the pass would not move anything
+inline bool TrivialPass(const Histogram& histogram, std::size_t count)
+{
+    return std::any_of(histogram.begin(), histogram.end(), [count](std::uint32_t n) { return n == count; });
+}
+
+//Parallel passes split the input in at most this many contiguous blocks, one histogram each
+constexpr std::size_t maxBlocks = 64;
+using BlockHistograms = std::array<Histogram, maxBlocks>;
+
+inline std::size_t BlockCount(const WorkStealingPool& pool, std::size_t count)
+{
+    return std::min({pool.ThreadCount(), maxBlocks, std::max<std::size_t>(1, count / 4096)});
+}
+
+//Turns per-block counts into per-block write offsets, bucket major then block minor, so every block writes its
+//own range of each bucket and the pass stays stable. Returns the bucket totals.
+inline Histogram BlockOffsets(BlockHistograms& histograms, std::size_t blocks)
+{
+    Histogram total{};
+    std::uint32_t sum = 0;
+    for (std::size_t bucket = 0; bucket < buckets; bucket++)
+    {
+        for (std::size_t block = 0; block < blocks; block++)
+        {
+            const std::uint32_t n = histograms[block][bucket];
+            histograms[block][bucket] = sum;
+            sum += n;
+            total[bucket] += n;
+        }
+    }
+    return total;
+}
+
+template<typename Payload>
+void FinishInPlace(std::span<std::uint32_t> keys, std::span<Payload> payloads, const std::uint32_t* sortedKeys,
+                   const Payload* sortedPayloads)
+{
+    if (sortedKeys != keys.data())
+    {
+        std::memcpy(keys.data(), sortedKeys, keys.size_bytes());
+        std::memcpy(payloads.data(), sortedPayloads, payloads.size_bytes());
+    }
+}
+}
+
+//Maps a float to a key whose unsigned order is the float order
+inline std::uint32_t SortableKey(float value)
+{
+    const auto bits = std::bit_cast<std::uint32_t>(value);
+    return bits ^ ((bits >> 31) != 0 ? 0xFFFFFFFFu : 0x80000000u);
+}
+
+template<typename Payload>
+void RadixSort(std::span<std::uint32_t> keys, std::span<Payload> payloads, std::span<std::uint32_t> keyScratch,
+               std::span<Payload> payloadScratch)
+{
+    using namespace radix_sort_detail;
+    const std::size_t count = keys.size();
+    //One read computes the histograms of every pass
+    std::array<Histogram, passes> histograms{};
+    for (const auto key : keys)
+    {
+        for (int pass = 0; pass < passes; pass++)
+        {
+            histograms[pass][Digit(key, pass)]++;
+        }
+    }
+
+    std::uint32_t* sourceKeys = keys.data();
+    Payload* sourcePayloads = payloads.data();
+    std::uint32_t* targetKeys = keyScratch.data();
+    Payload* targetPayloads = payloadScratch.data();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        if (TrivialPass(histograms[pass], count))
+        {
+            continue;
+        }
+        Histogram offsets;
+        std::uint32_t sum = 0;
+        for (std::size_t bucket = 0; bucket < buckets; bucket++)
+        {
+            offsets[bucket] = sum;
+            sum += histograms[pass][bucket];
+        }
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const std::uint32_t slot = offsets[Digit(sourceKeys[i], pass)]++;
+            targetKeys[slot] = sourceKeys[i];
+            targetPayloads[slot] = sourcePayloads[i];
+        }
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourcePayloads, targetPayloads);
+    }
+    radix_sort_detail::FinishInPlace(keys, payloads, sourceKeys, sourcePayloads);
+}
+
+//Each worker histograms and scatters its own contiguous block, blocks write disjoint ranges of every
+//bucket so the sort stays stable
+template<typename Payload>
+void ParallelRadixSort(WorkStealingPool& pool, std::span<std::uint32_t> keys, std::span<Payload> payloads,
+                       std::span<std::uint32_t> keyScratch, std::span<Payload> payloadScratch)
+{
+    using namespace radix_sort_detail;
+    const std::size_t count = keys.size();
+    const std::size_t blocks = BlockCount(pool, count);
+    if (blocks <= 1)
+    {
+        RadixSort(keys, payloads, keyScratch, payloadScratch);
+        return;
+    }
+    const std::size_t blockSize = (count + blocks - 1) / blocks;
+    BlockHistograms histograms;
+
+    std::uint32_t* sourceKeys = keys.data();
+    Payload* sourcePayloads = payloads.data();
+    std::uint32_t* targetKeys = keyScratch.data();
+    Payload* targetPayloads = payloadScratch.data();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        ParallelFor(pool, blocks, 1, [&](std::size_t first, std::size_t last)
+        {
+            for (std::size_t block = first; block < last; block++)
+            {
+                auto& histogram = histograms[block];
+                histogram.fill(0);
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; i++)
+                {
+                    histogram[Digit(sourceKeys[i], pass)]++;
+                }
+            }
+        });
+        if (TrivialPass(BlockOffsets(histograms, blocks), count))
+        {
+            continue;
+        }
+
+        ParallelFor(pool, blocks, 1, [&](std::size_t first, std::size_t last)
+        {
+            for (std::size_t block = first; block < last; block++)
+            {
+                auto& offsets = histograms[block];
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; i++)
+                {
+                    const std::uint32_t slot = offsets[Digit(sourceKeys[i], pass)]++;
+                    targetKeys[slot] = sourceKeys[i];
+                    targetPayloads[slot] = sourcePayloads[i];
+                }
+            }
+        });
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourcePayloads, targetPayloads);
+    }
+    radix_sort_detail::FinishInPlace(keys, payloads, sourceKeys, sourcePayloads);
+}
+
+//Where each key's group begins in a partitioned output, the group of key k is [offsets[k], offsets[k + 1])
+using RadixBuckets = std::array<std::uint32_t, radix_sort_detail::buckets + 1>;
+
+//Stable partition of payloads on keys below 256: a single counting pass of the radix sort, without moving the
+//keys. Cheaper than a sort when the key is a small category (a predicate, a type).
+template<typename Key, typename Payload>
+RadixBuckets RadixPartition(std::span<const Key> keys, std::span<const Payload> payloads, std::span<Payload> out)
+{
+    using namespace radix_sort_detail;
+    Histogram histogram{};
+    for (const auto key : keys)
+    {
+        histogram[static_cast<std::uint32_t>(key)]++;
+    }
+    RadixBuckets offsets{};
+    for (std::size_t bucket = 0; bucket < buckets; bucket++)
+    {
+        offsets[bucket + 1] = offsets[bucket] + histogram[bucket];
+    }
+    Histogram cursor;
+    std::copy_n(offsets.begin(), buckets, cursor.begin());
+    for (std::size_t i = 0; i < keys.size(); i++)
+    {
+        out[cursor[static_cast<std::uint32_t>(keys[i])]++] = payloads[i];
+    }
+    return offsets;
+}
+
+template<typename Key, typename Payload>
+RadixBuckets ParallelRadixPartition(WorkStealingPool& pool, std::span<const Key> keys,
+                                    std::span<const Payload> payloads, std::span<Payload> out)
+{
+    using namespace radix_sort_detail;
+    const std::size_t count = keys.size();
+    const std::size_t blocks = BlockCount(pool, count);
+    if (blocks <= 1)
+    {
+        return RadixPartition(keys, payloads, out);
+    }
+    const std::size_t blockSize = (count + blocks - 1) / blocks;
+    BlockHistograms histograms;
+    ParallelFor(pool, blocks, 1, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t block = first; block < last; block++)
+        {
+            auto& histogram = histograms[block];
+            histogram.fill(0);
+            const std::size_t end = std::min(count, (block + 1) * blockSize);
+            for (std::size_t i = block * blockSize; i < end; i++)
+            {
+                histogram[static_cast<std::uint32_t>(keys[i])]++;
+            }
+        }
+    });
+    const Histogram total = BlockOffsets(histograms, blocks);
+    ParallelFor(pool, blocks, 1, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t block = first; block < last; block++)
+        {
+            auto& offsets = histograms[block];
+            const std::size_t end = std::min(count, (block + 1) * blockSize);
+            for (std::size_t i = block * blockSize; i < end; i++)
+            {
+                out[offsets[static_cast<std::uint32_t>(keys[i])]++] = payloads[i];
+            }
+        }
+    });
+
+    RadixBuckets offsets{};
+    for (std::size_t bucket = 0; bucket < buckets; bucket++)
+    {
+        offsets[bucket + 1] = offsets[bucket] + total[bucket];
+    }
+    return offsets;
+}
+
+//Cheap when the input is nearly sorted, e.g. last frame's order with keys that moved a little
+template<typename Payload>
+void InsertionSort(std::span<std::uint32_t> keys, std::span<Payload> payloads)
+{
+    for (std::size_t i = 1; i < keys.size(); i++)
+    {
+        const std::uint32_t key = keys[i];
+        if (keys[i - 1] <= key)
+        {
+            continue;
+        }
+        const Payload payload = payloads[i];
+        std::size_t j = i;
+        while (j > 0 && keys[j - 1] > key)
+        {
+            keys[j] = keys[j - 1];
+            payloads[j] = payloads[j - 1];
+            j--;
+        }
+        keys[j] = key;
+        payloads[j] = payload;
+    }
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "intrinsics.h"
+
+#if defined(_MSC_VER)
+#define RESTRICT __restrict
+#else
+#define RESTRICT __restrict__
+#endif
+
+//Hides a value from the optimizer so -ffast-math cannot reassociate compensation terms away
+template<typename T>
+inline void Opaque(T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : "+x"(value));
+#else
+	volatile T copy = value;
+	value = copy;
+#endif
+}
+
+//AdderAlias with the promise that total does not alias values: the total stays in a register
+inline void AddRestrict(int* RESTRICT total, const int* RESTRICT values, const std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+	{
+		*total += values[i];
+	}
+}
+
+//Four independent vector accumulators hide the add latency
+inline int SumAvx2(const int* values, const std::size_t count)
+{
+	std::size_t i = 0;
+	int total = 0;
+#ifdef __AVX2__
+	__m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+	__m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+	for (; i + 32 <= count; i += 32)
+	{
+		acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+		acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 8)));
+		acc2 = _mm256_add_epi32(acc2, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 16)));
+		acc3 = _mm256_add_epi32(acc3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 24)));
+	}
+	const __m256i acc = _mm256_add_epi32(_mm256_add_epi32(acc0, acc1), _mm256_add_epi32(acc2, acc3));
+	alignas(32) int lanes[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+	for (const int lane : lanes)
+	{
+		total += lane;
+	}
+#endif
+	for (; i < count; i++)
+	{
+		total += values[i];
+	}
+	return total;
+}
+
+//Sign-extends each int32 to int64 before accumulating, the total cannot overflow below 2^32 elements
+inline std::int64_t SumWiden(const int* values, const std::size_t count)
+{
+	std::size_t i = 0;
+	std::int64_t total = 0;
+#ifdef __AVX2__
+	__m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+	__m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+	for (; i + 16 <= count; i += 16)
+	{
+		acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i))));
+		acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 4))));
+		acc2 = _mm256_add_epi64(acc2, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 8))));
+		acc3 = _mm256_add_epi64(acc3, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 12))));
+	}
+	const __m256i acc = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3));
+	alignas(32) std::int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+	for (const std::int64_t lane : lanes)
+	{
+		total += lane;
+	}
+#endif
+	for (; i < count; i++)
+	{
+		total += values[i];
+	}
+	return total;
+}
+
+//Compensated summation, the error does not grow with count
+inline float SumKahan(const float* values, const std::size_t count)
+{
+	float sum = 0.0f;
+	float compensation = 0.0f;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const float y = values[i] - compensation;
+		float t = sum + y;
+		Opaque(t);
+		compensation = (t - sum) - y;
+		sum = t;
+	}
+	return sum;
+}
+
+//Error grows with log(count), the leaves stay plain vectorizable loops
+inline float SumPairwise(const float* values, const std::size_t count)
+{
+	constexpr std::size_t leafSize = 128;
+	if (count <= leafSize)
+	{
+		float sum = 0.0f;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			sum += values[i];
+		}
+		return sum;
+	}
+	const std::size_t half = count / 2;
+	return SumPairwise(values, half) + SumPairwise(values + half, count - half);
+}
+
+//Persistent workers for ParallelTreeSum, the calling thread is worker 0 and threadCount - 1 threads are started
+//once. A sum publishes its input and bumps the generation, which wakes the workers, so it costs the partial
+//sums and the tree combine instead of creating and joining threads.
+class TreeSumWorkers
+{
+public:
+	explicit TreeSumWorkers(const int threadCount) : m_Partials(std::max(1, threadCount))
+	{
+		for (int i = 1; i < ThreadCount(); i++)
+		{
+			m_Threads.emplace_back([this, i] { WorkerLoop(i); });
+		}
+	}
+	~TreeSumWorkers()
+	{
+		m_Stop.store(true, std::memory_order_relaxed);
+		m_Generation.fetch_add(1, std::memory_order_release);
+		m_Generation.notify_all();
+		for (auto& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+	TreeSumWorkers(const TreeSumWorkers&) = delete;
+	TreeSumWorkers& operator=(const TreeSumWorkers&) = delete;
+
+	[[nodiscard]] int ThreadCount() const { return static_cast<int>(m_Partials.size()); }
+
+	//Thread 0 is the root of the tree, every worker has published its subtree when it returns
+	std::int64_t Sum(const int* values, const std::size_t count)
+	{
+		m_Values = values;
+		m_Count = count;
+		const std::uint64_t generation = m_Generation.fetch_add(1, std::memory_order_release) + 1;
+		m_Generation.notify_all();
+		Work(0, generation);
+		return m_Partials[0].value;
+	}
+
+private:
+	//done holds the generation of the last published value, so it never needs a reset between sums
+	struct alignas(64) Partial
+	{
+		std::int64_t value = 0;
+		std::atomic<std::uint64_t> done{0};
+	};
+
+	void WorkerLoop(const int i)
+	{
+		std::uint64_t seen = 0;
+		while (true)
+		{
+			m_Generation.wait(seen, std::memory_order_acquire);
+			seen = m_Generation.load(std::memory_order_acquire);
+			if (m_Stop.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+			Work(i, seen);
+		}
+	}
+
+	//Each thread widens and sums its chunk, partials are then combined pairwise along a binary tree:
+	//at level stride, thread i (a multiple of 2 * stride) waits for thread i + stride and adds its subtree.
+	void Work(const int i, const std::uint64_t generation)
+	{
+		const int threads = ThreadCount();
+		const std::size_t chunk = (m_Count + threads - 1) / threads;
+		const std::size_t begin = std::min(m_Count, chunk * i);
+		const std::size_t end = std::min(m_Count, begin + chunk);
+		std::int64_t value = SumWiden(m_Values + begin, end - begin);
+		for (int stride = 1; stride < threads; stride *= 2)
+		{
+			if (i & stride)
+			{
+				break;
+			}
+			const int partner = i + stride;
+			if (partner < threads)
+			{
+				while (m_Partials[partner].done.load(std::memory_order_acquire) != generation)
+				{
+					std::this_thread::yield();
+				}
+				value += m_Partials[partner].value;
+			}
+		}
+		m_Partials[i].value = value;
+		m_Partials[i].done.store(generation, std::memory_order_release);
+	}
+
+	std::vector<Partial> m_Partials;
+	std::vector<std::thread> m_Threads;
+	const int* m_Values = nullptr;
+	std::size_t m_Count = 0;
+	alignas(64) std::atomic<std::uint64_t> m_Generation{0};
+	std::atomic<bool> m_Stop{false};
+};
+
+//Widens and sums on ThreadCount() threads of the workers
+inline std::int64_t ParallelTreeSum(TreeSumWorkers& workers, const int* values, const std::size_t count)
+{
+	return workers.Sum(values, count);
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "intrinsics.h"
+
+//sin and cos of a whole register of angles in degrees, like the transform systems store them.
+//The angle is reduced by quarter turns, x = 90 q + r with |r| <= 45: with an FMA the remainder is exact, so
+//unlike a reduction by an approximation of pi/2 there is no cancellation near the zeros. A minimax polynomial
+//then evaluates sin and cos of r in radians and the quadrant q swaps and negates them.
+enum class SinCosAccuracy
+{
+    Fast,    //degree 5 sin, degree 4 cos, about 1e-5 relative error
+    Precise, //degree 7 sin, degree 8 cos, within 2 ULP
+};
+
+namespace sincos_detail
+{
+constexpr float degToRad = 0.0174532925199432958f;
+constexpr std::uint32_t signBit = 0x80000000u;
+
+//Coefficients in r^2: sin(r) = r * P(r^2) and cos(r) = Q(r^2) on [-pi/4, pi/4], fitted with the Remez algorithm
+//on relative error
+template<SinCosAccuracy A>
+struct Coefficients;
+
+template<>
+struct Coefficients<SinCosAccuracy::Fast>
+{
+    static constexpr std::array<float, 3> sine{9.999984929e-01f, -1.666238231e-01f, 8.150056556e-03f};
+    static constexpr std::array<float, 3> cosine{9.999882169e-01f, -4.996854847e-01f, 4.036229394e-02f};
+};
+
+template<>
+struct Coefficients<SinCosAccuracy::Precise>
+{
+    static constexpr std::array<float, 4> sine{1.0f, -1.666665022e-01f, 8.332016453e-03f, -1.950182202e-04f};
+    static constexpr std::array<float, 5> cosine{1.0f, -0.5f, 4.166661323e-02f, -1.388652915e-03f,
+                                                 2.437267921e-05f};
+};
+
+//One lane, for blocks that are not a multiple of a register and as the scalar reference of the same algorithm
+struct Scalar
+{
+    using Vec = float;
+    using Int = std::int32_t;
+    static constexpr std::size_t width = 1;
+    static Vec Load(const float* p) { return *p; }
+    static void Store(float* p, Vec v) { *p = v; }
+    static Vec Set1(float x) { return x; }
+    static Vec Mul(Vec a, Vec b) { return a * b; }
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return std::fma(a, b, c); }
+    static Vec Negate(Vec v) { return -v; }
+    static Int RoundToInt(Vec v) { return static_cast<Int>(std::lrint(v)); }
+    static Vec ToFloat(Int i) { return static_cast<Vec>(i); }
+    static Int AddInt(Int i, std::int32_t n) { return i + n; }
+    //Bit 1 of i moved to the sign bit
+    static Int Bit1ToSign(Int i) { return static_cast<Int>((static_cast<std::uint32_t>(i) << 30) & signBit); }
+    static Vec XorSign(Vec v, Int sign) { return std::bit_cast<float>(std::bit_cast<Int>(v) ^ sign); }
+    static Vec SelectOdd(Int i, Vec ifOdd, Vec ifEven) { return (i & 1) != 0 ? ifOdd : ifEven; }
+};
+
+#ifdef __SSE4_1__
+struct Sse
+{
+    using Vec = __m128;
+    using Int = __m128i;
+    static constexpr std::size_t width = 4;
+    static Vec Load(const float* p) { return _mm_load_ps(p); }
+    static void Store(float* p, Vec v) { _mm_store_ps(p, v); }
+    static Vec Set1(float x) { return _mm_set1_ps(x); }
+    static Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+#ifdef __FMA__
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_fmadd_ps(a, b, c); }
+#else
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+    static Vec Negate(Vec v) { return _mm_xor_ps(v, _mm_castsi128_ps(_mm_set1_epi32(signBit))); }
+    static Int RoundToInt(Vec v) { return _mm_cvtps_epi32(v); }
+    static Vec ToFloat(Int i) { return _mm_cvtepi32_ps(i); }
+    static Int AddInt(Int i, std::int32_t n) { return _mm_add_epi32(i, _mm_set1_epi32(n)); }
+    static Int Bit1ToSign(Int i) { return _mm_and_si128(_mm_slli_epi32(i, 30), _mm_set1_epi32(signBit)); }
+    static Vec XorSign(Vec v, Int sign) { return _mm_xor_ps(v, _mm_castsi128_ps(sign)); }
+    static Vec SelectOdd(Int i, Vec ifOdd, Vec ifEven)
+    {
+        return _mm_blendv_ps(ifEven, ifOdd, _mm_castsi128_ps(_mm_slli_epi32(i, 31)));
+    }
+};
+#endif
+
+#ifdef __AVX2__
+struct Avx
+{
+    using Vec = __m256;
+    using Int = __m256i;
+    static constexpr std::size_t width = 8;
+    static Vec Load(const float* p) { return _mm256_load_ps(p); }
+    static void Store(float* p, Vec v) { _mm256_store_ps(p, v); }
+    static Vec Set1(float x) { return _mm256_set1_ps(x); }
+    static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+#ifdef __FMA__
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    static Vec Negate(Vec v) { return _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(signBit))); }
+    static Int RoundToInt(Vec v) { return _mm256_cvtps_epi32(v); }
+    static Vec ToFloat(Int i) { return _mm256_cvtepi32_ps(i); }
+    static Int AddInt(Int i, std::int32_t n) { return _mm256_add_epi32(i, _mm256_set1_epi32(n)); }
+    static Int Bit1ToSign(Int i) { return _mm256_and_si256(_mm256_slli_epi32(i, 30), _mm256_set1_epi32(signBit)); }
+    static Vec XorSign(Vec v, Int sign) { return _mm256_xor_ps(v, _mm256_castsi256_ps(sign)); }
+    static Vec SelectOdd(Int i, Vec ifOdd, Vec ifEven)
+    {
+        return _mm256_blendv_ps(ifEven, ifOdd, _mm256_castsi256_ps(_mm256_slli_epi32(i, 31)));
+    }
+};
+#endif
+
+#ifdef __AVX512F__
+//Only AVX-512F: the float xor of AVX-512DQ is done on the integer side
+struct Avx512
+{
+    using Vec = __m512;
+    using Int = __m512i;
+    static constexpr std::size_t width = 16;
+    static Vec Load(const float* p) { return _mm512_load_ps(p); }
+    static void Store(float* p, Vec v) { _mm512_store_ps(p, v); }
+    static Vec Set1(float x) { return _mm512_set1_ps(x); }
+    static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+    static Vec Negate(Vec v) { return XorSign(v, _mm512_set1_epi32(signBit)); }
+    static Int RoundToInt(Vec v) { return _mm512_cvtps_epi32(v); }
+    static Vec ToFloat(Int i) { return _mm512_cvtepi32_ps(i); }
+    static Int AddInt(Int i, std::int32_t n) { return _mm512_add_epi32(i, _mm512_set1_epi32(n)); }
+    static Int Bit1ToSign(Int i) { return _mm512_and_si512(_mm512_slli_epi32(i, 30), _mm512_set1_epi32(signBit)); }
+    static Vec XorSign(Vec v, Int sign)
+    {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), sign));
+    }
+    static Vec SelectOdd(Int i, Vec ifOdd, Vec ifEven)
+    {
+        return _mm512_mask_blend_ps(_mm512_test_epi32_mask(i, _mm512_set1_epi32(1)), ifEven, ifOdd);
+    }
+};
+#endif
+
+//Widest register that divides a block of N lanes
+template<std::size_t N>
+struct WidestFor
+{
+    using Type = Scalar;
+};
+#ifdef __SSE4_1__
+template<std::size_t N> requires (N % 4 == 0)
+struct WidestFor<N>
+{
+#ifdef __AVX512F__
+    using Type = std::conditional_t<N % 16 == 0, Avx512, std::conditional_t<N % 8 == 0, Avx, Sse>>;
+#elif defined(__AVX2__)
+    using Type = std::conditional_t<N % 8 == 0, Avx, Sse>;
+#else
+    using Type = Sse;
+#endif
+};
+#endif
+
+template<typename Simd, std::size_t Size>
+inline typename Simd::Vec Horner(const std::array<float, Size>& coefficients, typename Simd::Vec x)
+{
+    auto result = Simd::Set1(coefficients[Size - 1]);
+    for (std::size_t i = Size - 1; i > 0; i--)
+    {
+        result = Simd::MulAdd(result, x, Simd::Set1(coefficients[i - 1]));
+    }
+    return result;
+}
+}
+
+template<typename Simd, SinCosAccuracy A>
+inline void SinCosDegrees(typename Simd::Vec degrees, typename Simd::Vec& sine, typename Simd::Vec& cosine)
+{
+    using namespace sincos_detail;
+    const auto quadrant = Simd::RoundToInt(Simd::Mul(degrees, Simd::Set1(1.0f / 90.0f)));
+    const auto remainder = Simd::MulAdd(Simd::ToFloat(quadrant), Simd::Set1(-90.0f), degrees);
+    const auto radians = Simd::Mul(remainder, Simd::Set1(degToRad));
+    const auto squared = Simd::Mul(radians, radians);
+    const auto sinR = Simd::Mul(radians, Horner<Simd>(Coefficients<A>::sine, squared));
+    const auto cosR = Horner<Simd>(Coefficients<A>::cosine, squared);
+
+    //Quadrant 0: (sin r, cos r), 1: (cos r, -sin r), 2: (-sin r, -cos r), 3: (-cos r, sin r)
+    sine = Simd::XorSign(Simd::SelectOdd(quadrant, cosR, sinR), Simd::Bit1ToSign(quadrant));
+    cosine = Simd::XorSign(Simd::SelectOdd(quadrant, sinR, cosR), Simd::Bit1ToSign(Simd::AddInt(quadrant, 1)));
+}
@@ -0,0 +1,541 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+//Deferred registration: BENCH_SWEEP(BM_X)->Range(8, 1 << 20) records the builder chain instead of
+//registering right away. ConfigureSweeps() registers every sweep in main, after replacing the
+//argument and thread sweeps of the benchmarks matched by the config file (--bench_config=<file>
+//or BENCH_CONFIG), so sizes can change without rebuilding. Config format:
+//
+//  [BM_01_Vtable*]          glob on the benchmark name, later sections override earlier ones
+//  range = 1k 64M 8         Range(lo, hi) with an optional multiplier
+//  dense = 12 30 2          DenseRange(lo, hi, step)
+//  args = 1<<22; 1<<24      one Args() per ';', values separated by spaces
+//  product = 1:4096:2 | 0 1 2   ArgsProduct, lo:hi:mult expands like CreateRange
+//  threads = 1 2 4 max      max is the hardware concurrency
+//  enabled = false          skips the benchmark, e.g. an ISA path or layout
+//  min_time = 0.5 / repetitions = 3 / iterations = 100
+//
+//Numbers are decimal, or hex with 0x, and accept k/M/G (powers of 1024) suffixes and a<<b.
+namespace sweep_detail
+{
+enum class OpKind
+{
+    Arguments,
+    Threads,
+    Other,
+};
+
+struct Op
+{
+    OpKind kind;
+    std::function<void(benchmark::internal::Benchmark*)> apply;
+};
+
+struct Override
+{
+    std::string pattern;
+    bool hasEnabled = false;
+    bool enabled = true;
+    std::vector<std::vector<int64_t>> args;
+    std::vector<int64_t> range;
+    std::vector<int64_t> dense;
+    std::vector<std::vector<int64_t>> product;
+    std::vector<int> threads;
+    double minTime = 0.0;
+    int repetitions = 0;
+    int64_t iterations = 0;
+};
+}
+
+class SweepBuilder
+{
+public:
+    using Benchmark = benchmark::internal::Benchmark;
+
+    SweepBuilder(std::string name, void (*function)(benchmark::State&))
+        : m_Name(std::move(name)), m_Function(function)
+    {
+    }
+
+    SweepBuilder* Arg(int64_t x)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->Arg(x); });
+    }
+    SweepBuilder* Args(const std::vector<int64_t>& args)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->Args(args); });
+    }
+    SweepBuilder* Range(int64_t start, int64_t limit)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->Range(start, limit); });
+    }
+    SweepBuilder* RangeMultiplier(int multiplier)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->RangeMultiplier(multiplier); });
+    }
+    SweepBuilder* DenseRange(int64_t start, int64_t limit, int step = 1)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->DenseRange(start, limit, step); });
+    }
+    SweepBuilder* ArgsProduct(const std::vector<std::vector<int64_t>>& product)
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->ArgsProduct(product); });
+    }
+    //Custom argument sweep
+    SweepBuilder* Apply(void (*custom)(Benchmark*))
+    {
+        return Add(Kind::Arguments, [=](Benchmark* b) { b->Apply(custom); });
+    }
+    //Custom thread sweep
+    SweepBuilder* ApplyThreads(void (*custom)(Benchmark*))
+    {
+        return Add(Kind::Threads, [=](Benchmark* b) { b->Apply(custom); });
+    }
+    SweepBuilder* Threads(int threads)
+    {
+        return Add(Kind::Threads, [=](Benchmark* b) { b->Threads(threads); });
+    }
+
+    SweepBuilder* ArgName(const std::string& name)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->ArgName(name); });
+    }
+    SweepBuilder* ArgNames(const std::vector<std::string>& names)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->ArgNames(names); });
+    }
+    SweepBuilder* UseRealTime()
+    {
+        return Add(Kind::Other, [](Benchmark* b) { b->UseRealTime(); });
+    }
+    SweepBuilder* Unit(benchmark::TimeUnit unit)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->Unit(unit); });
+    }
+    SweepBuilder* MinTime(double seconds)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->MinTime(seconds); });
+    }
+    SweepBuilder* Repetitions(int repetitions)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->Repetitions(repetitions); });
+    }
+    SweepBuilder* ReportAggregatesOnly(bool value = true)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->ReportAggregatesOnly(value); });
+    }
+    //Only the console shows aggregates, --benchmark_out still gets every repetition
+    SweepBuilder* DisplayAggregatesOnly(bool value = true)
+    {
+        return Add(Kind::Other, [=](Benchmark* b) { b->DisplayAggregatesOnly(value); });
+    }
+
+    [[nodiscard]] const std::string& Name() const { return m_Name; }
+
+    //Registers the benchmark, the override replaces the recorded sweeps of the kinds it sets
+    bool Register(const sweep_detail::Override& override) const
+    {
+        if (override.hasEnabled && !override.enabled)
+        {
+            return false;
+        }
+        const bool replaceArguments = !override.args.empty() || !override.range.empty() ||
+                                      !override.dense.empty() || !override.product.empty();
+        const bool replaceThreads = !override.threads.empty();
+        Benchmark* b = benchmark::RegisterBenchmark(m_Name.c_str(), m_Function);
+        for (const auto& op : m_Ops)
+        {
+            if ((op.kind == Kind::Arguments && replaceArguments) || (op.kind == Kind::Threads && replaceThreads))
+            {
+                continue;
+            }
+            op.apply(b);
+        }
+        for (const auto& args : override.args)
+        {
+            b->Args(args);
+        }
+        if (!override.range.empty())
+        {
+            b->RangeMultiplier(override.range.size() > 2 ? static_cast<int>(override.range[2]) : 8);
+            b->Range(override.range[0], override.range.size() > 1 ? override.range[1] : override.range[0]);
+        }
+        if (!override.dense.empty())
+        {
+            b->DenseRange(override.dense[0], override.dense.size() > 1 ? override.dense[1] : override.dense[0],
+                          override.dense.size() > 2 ? static_cast<int>(override.dense[2]) : 1);
+        }
+        if (!override.product.empty())
+        {
+            b->ArgsProduct(override.product);
+        }
+        for (const int threads : override.threads)
+        {
+            b->Threads(threads);
+        }
+        if (override.minTime > 0.0)
+        {
+            b->MinTime(override.minTime);
+        }
+        if (override.repetitions > 0)
+        {
+            b->Repetitions(override.repetitions);
+        }
+        if (override.iterations > 0)
+        {
+            b->Iterations(override.iterations);
+        }
+        return true;
+    }
+
+private:
+    using Kind = sweep_detail::OpKind;
+
+    SweepBuilder* Add(Kind kind, std::function<void(Benchmark*)> apply)
+    {
+        m_Ops.push_back({kind, std::move(apply)});
+        return this;
+    }
+
+    std::string m_Name;
+    void (*m_Function)(benchmark::State&);
+    std::vector<sweep_detail::Op> m_Ops;
+};
+
+namespace sweep_detail
+{
+//Builders live until exit, the registry keeps them in declaration order
+inline std::vector<SweepBuilder*>& Registry()
+{
+    static std::vector<SweepBuilder*> registry;
+    return registry;
+}
+
+inline SweepBuilder* AddSweep(const char* name, void (*function)(benchmark::State&))
+{
+    auto* builder = new SweepBuilder(name, function);
+    Registry().push_back(builder);
+    return builder;
+}
+
+inline bool GlobMatch(const char* pattern, const char* text)
+{
+    if (*pattern == '\0')
+    {
+        return *text == '\0';
+    }
+    if (*pattern == '*')
+    {
+        return GlobMatch(pattern + 1, text) || (*text != '\0' && GlobMatch(pattern, text + 1));
+    }
+    return *text != '\0' && (*pattern == '?' || *pattern == *text) && GlobMatch(pattern + 1, text + 1);
+}
+
+inline std::string Trim(const std::string& text)
+{
+    const auto first = text.find_first_not_of(" \t\r");
+    const auto last = text.find_last_not_of(" \t\r");
+    return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+inline std::vector<std::string> Split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator))
+    {
+        part = Trim(part);
+        if (!part.empty())
+        {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+//"4096", "64k", "1<<22", "0x1000", decimal unless 0x, returns false on anything else
+inline bool ParseNumber(const std::string& token, int64_t& value)
+{
+    const auto shift = token.find("<<");
+    if (shift != std::string::npos)
+    {
+        int64_t base = 0;
+        int64_t bits = 0;
+        if (!ParseNumber(token.substr(0, shift), base) || !ParseNumber(token.substr(shift + 2), bits))
+        {
+            return false;
+        }
+        value = base << bits;
+        return true;
+    }
+    const bool hex = token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X');
+    const char* digits = token.c_str() + (hex ? 2 : 0);
+    char* end = nullptr;
+    value = std::strtoll(digits, &end, hex ? 16 : 10);
+    if (end == digits)
+    {
+        return false;
+    }
+    switch (*end)
+    {
+    case 'k': case 'K': value <<= 10; end++; break;
+    case 'm': case 'M': value <<= 20; end++; break;
+    case 'g': case 'G': value <<= 30; end++; break;
+    default: break;
+    }
+    return *end == '\0';
+}
+
+inline bool ParseNumbers(const std::string& text, std::vector<int64_t>& values)
+{
+    for (const auto& token : Split(text, ' '))
+    {
+        //lo:hi:mult, the same values as benchmark::CreateRange
+        const auto colon = token.find(':');
+        if (colon != std::string::npos)
+        {
+            const auto bounds = Split(token, ':');
+            int64_t lo = 0;
+            int64_t hi = 0;
+            int64_t multiplier = 2;
+            if (bounds.size() < 2 || !ParseNumber(bounds[0], lo) || !ParseNumber(bounds[1], hi) ||
+                (bounds.size() > 2 && !ParseNumber(bounds[2], multiplier)) || multiplier < 2)
+            {
+                return false;
+            }
+            const auto range = benchmark::CreateRange(lo, hi, static_cast<int>(multiplier));
+            values.insert(values.end(), range.begin(), range.end());
+            continue;
+        }
+        int64_t value = 0;
+        if (!ParseNumber(token, value))
+        {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+inline bool ParseKey(Override& override, const std::string& key, const std::string& value)
+{
+    if (key == "enabled")
+    {
+        override.hasEnabled = true;
+        override.enabled = value == "true" || value == "1" || value == "on";
+        return override.enabled || value == "false" || value == "0" || value == "off";
+    }
+    if (key == "args")
+    {
+        for (const auto& group : Split(value, ';'))
+        {
+            std::vector<int64_t> args;
+            if (!ParseNumbers(group, args))
+            {
+                return false;
+            }
+            override.args.push_back(args);
+        }
+        return !override.args.empty();
+    }
+    if (key == "range")
+    {
+        override.range.clear();
+        return ParseNumbers(value, override.range) && override.range.size() <= 3;
+    }
+    if (key == "dense")
+    {
+        override.dense.clear();
+        return ParseNumbers(value, override.dense) && override.dense.size() <= 3;
+    }
+    if (key == "product")
+    {
+        override.product.clear();
+        for (const auto& group : Split(value, '|'))
+        {
+            std::vector<int64_t> values;
+            if (!ParseNumbers(group, values))
+            {
+                return false;
+            }
+            override.product.push_back(values);
+        }
+        return !override.product.empty();
+    }
+    if (key == "threads")
+    {
+        override.threads.clear();
+        for (const auto& token : Split(value, ' '))
+        {
+            int64_t threads = 0;
+            if (token == "max")
+            {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            else if (!ParseNumber(token, threads) || threads < 1)
+            {
+                return false;
+            }
+            override.threads.push_back(static_cast<int>(threads));
+        }
+        return !override.threads.empty();
+    }
+    if (key == "min_time")
+    {
+        override.minTime = std::atof(value.c_str());
+        return override.minTime > 0.0;
+    }
+    if (key == "repetitions")
+    {
+        int64_t repetitions = 0;
+        override.repetitions = ParseNumber(value, repetitions) ? static_cast<int>(repetitions) : 0;
+        return override.repetitions > 0;
+    }
+    if (key == "iterations")
+    {
+        return ParseNumber(value, override.iterations) && override.iterations > 0;
+    }
+    return false;
+}
+
+inline bool LoadConfig(const char* path, std::vector<Override>& overrides)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::fprintf(stderr, "sweep: cannot open config %s\n", path);
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']')
+        {
+            Override section;
+            section.pattern = Trim(line.substr(1, line.size() - 2));
+            overrides.push_back(std::move(section));
+            continue;
+        }
+        const auto equal = line.find('=');
+        if (overrides.empty() || equal == std::string::npos ||
+            !ParseKey(overrides.back(), Trim(line.substr(0, equal)), Trim(line.substr(equal + 1))))
+        {
+            std::fprintf(stderr, "sweep: %s:%d: cannot parse '%s'\n", path, lineNumber, line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+//Merges the matching sections, later keys win
+inline Override Resolve(const std::vector<Override>& overrides, const std::string& name)
+{
+    Override merged;
+    for (const auto& override : overrides)
+    {
+        if (!GlobMatch(override.pattern.c_str(), name.c_str()))
+        {
+            continue;
+        }
+        if (override.hasEnabled)
+        {
+            merged.hasEnabled = true;
+            merged.enabled = override.enabled;
+        }
+        if (!override.args.empty() || !override.range.empty() || !override.dense.empty() || !override.product.empty())
+        {
+            merged.args = override.args;
+            merged.range = override.range;
+            merged.dense = override.dense;
+            merged.product = override.product;
+        }
+        if (!override.threads.empty())
+        {
+            merged.threads = override.threads;
+        }
+        merged.minTime = override.minTime > 0.0 ? override.minTime : merged.minTime;
+        merged.repetitions = override.repetitions > 0 ? override.repetitions : merged.repetitions;
+        merged.iterations = override.iterations > 0 ? override.iterations : merged.iterations;
+    }
+    return merged;
+}
+}
+
+#define BENCH_SWEEP_CONCAT2(a, b) a##b
+#define BENCH_SWEEP_CONCAT(a, b) BENCH_SWEEP_CONCAT2(a, b)
+#define BENCH_SWEEP_NAME BENCH_SWEEP_CONCAT(benchSweep_, __LINE__)
+
+#define BENCH_SWEEP(function) \
+    [[maybe_unused]] static SweepBuilder* BENCH_SWEEP_NAME = sweep_detail::AddSweep(#function, function)
+#define BENCH_SWEEP_TEMPLATE(function, ...) \
+    [[maybe_unused]] static SweepBuilder* BENCH_SWEEP_NAME = \
+        sweep_detail::AddSweep(#function "<" #__VA_ARGS__ ">", function<__VA_ARGS__>)
+
+//Strips --bench_config=<file> and --bench_list_sweeps, then registers every recorded sweep.
+//Call it before benchmark::Initialize, returns false when the config is invalid.
+inline bool ConfigureSweeps(int& argc, char** argv)
+{
+    using namespace sweep_detail;
+    const char* configPath = std::getenv("BENCH_CONFIG");
+    bool list = false;
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "--bench_config=", 15) == 0)
+        {
+            configPath = argv[i] + 15;
+        }
+        else if (std::strcmp(argv[i], "--bench_list_sweeps") == 0)
+        {
+            list = true;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = nullptr;
+
+    std::vector<Override> overrides;
+    if (configPath != nullptr && configPath[0] != '\0' && !LoadConfig(configPath, overrides))
+    {
+        return false;
+    }
+    for (const auto* builder : Registry())
+    {
+        if (list)
+        {
+            std::printf("%s\n", builder->Name().c_str());
+            continue;
+        }
+        builder->Register(Resolve(overrides, builder->Name()));
+    }
+    if (list)
+    {
+        std::exit(0);
+    }
+    return true;
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//Frame scheduler: systems declare the resources (e.g. ecs::ComponentId) they read and write, the graph
+//orders conflicting systems by declaration order and lets the others run concurrently. Each system is
+//split into ranges of its items that run as separate tasks on a work-stealing pool.
+struct PoolTask
+{
+    void (*run)(void* context, std::size_t begin, std::size_t end);
+    void* context;
+    std::size_t begin;
+    std::size_t end;
+};
+
+namespace task_graph_detail
+{
+inline thread_local std::size_t currentWorker = 0;
+}
+
+//One deque per worker: owners push and pop at the back, thieves take the oldest task at the front.
+//The thread calling RunUntil is worker 0, the pool starts threadCount - 1 threads.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(std::size_t threadCount)
+    {
+        threadCount = std::max<std::size_t>(1, threadCount);
+        for (std::size_t i = 0; i < threadCount; i++)
+        {
+            m_Queues.push_back(std::make_unique<Queue>());
+        }
+        for (std::size_t i = 1; i < threadCount; i++)
+        {
+            m_Threads.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard lock(m_SleepMutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (auto& thread : m_Threads)
+        {
+            thread.join();
+        }
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    [[nodiscard]] std::size_t ThreadCount() const { return m_Queues.size(); }
+
+    //Pushes on the queue of the calling worker
+    void Push(const PoolTask& task)
+    {
+        auto& queue = *m_Queues[std::min(task_graph_detail::currentWorker, m_Queues.size() - 1)];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    //Runs tasks on the calling thread, with the workers awake, until done() returns true
+    template<typename Done>
+    void RunUntil(Done&& done)
+    {
+        task_graph_detail::currentWorker = 0;
+        {
+            std::lock_guard lock(m_SleepMutex);
+            m_Sessions++;
+        }
+        m_Wake.notify_all();
+        while (!done())
+        {
+            if (!TryRunOne(0))
+            {
+                std::this_thread::yield();
+            }
+        }
+        std::lock_guard lock(m_SleepMutex);
+        m_Sessions--;
+    }
+
+    [[nodiscard]] std::uint64_t Steals() const { return m_Steals.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<PoolTask> tasks;
+    };
+
+    bool TryRunOne(std::size_t worker)
+    {
+        PoolTask task{};
+        bool found = false;
+        {
+            auto& own = *m_Queues[worker];
+            std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                found = true;
+            }
+        }
+        for (std::size_t i = 1; !found && i < m_Queues.size(); i++)
+        {
+            auto& victim = *m_Queues[(worker + i) % m_Queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                found = true;
+                m_Steals.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (found)
+        {
+            task.run(task.context, task.begin, task.end);
+        }
+        return found;
+    }
+
+    //Spins while a frame is running, sleeps between frames
+    void WorkerLoop(std::size_t worker)
+    {
+        task_graph_detail::currentWorker = worker;
+        while (true)
+        {
+            if (TryRunOne(worker))
+            {
+                continue;
+            }
+            std::unique_lock lock(m_SleepMutex);
+            if (m_Sessions > 0)
+            {
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            m_Wake.wait(lock, [this] { return m_Stop || m_Sessions > 0; });
+            if (m_Stop)
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+    std::vector<std::thread> m_Threads;
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wake;
+    int m_Sessions = 0;
+    bool m_Stop = false;
+    std::atomic<std::uint64_t> m_Steals{0};
+};
+
+//Runs f(begin, end) over [0, count) in ranges of grain items on the pool and returns when all are done
+template<typename F>
+void ParallelFor(WorkStealingPool& pool, std::size_t count, std::size_t grain, F&& f)
+{
+    struct Context
+    {
+        std::remove_reference_t<F>* f;
+        std::atomic<std::size_t> remaining;
+    };
+    grain = std::max<std::size_t>(1, grain);
+    const std::size_t parts = (count + grain - 1) / grain;
+    if (parts <= 1 || pool.ThreadCount() == 1)
+    {
+        f(std::size_t{0}, count);
+        return;
+    }
+    Context context{&f, parts};
+    for (std::size_t part = 0; part < parts; part++)
+    {
+        pool.Push({[](void* opaque, std::size_t begin, std::size_t end)
+                   {
+                       auto& context = *static_cast<Context*>(opaque);
+                       (*context.f)(begin, end);
+                       context.remaining.fetch_sub(1, std::memory_order_acq_rel);
+                   },
+                   &context, part * grain, std::min(count, (part + 1) * grain)});
+    }
+    pool.RunUntil([&context] { return context.remaining.load(std::memory_order_acquire) == 0; });
+}
+
+class TaskGraph
+{
+public:
+    using Work = std::function<void(std::size_t begin, std::size_t end)>;
+
+    //items are split in ranges of at most grain items, each range is one task
+    std::size_t AddSystem(std::string name, const std::vector<std::uint32_t>& reads,
+                          const std::vector<std::uint32_t>& writes, std::size_t items, std::size_t grain, Work work)
+    {
+        auto node = std::make_unique<Node>();
+        node->graph = this;
+        node->name = std::move(name);
+        node->items = items;
+        node->grain = std::max<std::size_t>(1, grain);
+        node->work = std::move(work);
+        const std::size_t index = m_Nodes.size();
+
+        //Read after write, write after write and write after read become edges
+        for (const auto resource : writes)
+        {
+            auto& access = m_Access[resource];
+            if (access.lastWriter != none)
+            {
+                AddEdge(access.lastWriter, index, *node);
+            }
+            for (const auto reader : access.readers)
+            {
+                AddEdge(reader, index, *node);
+            }
+        }
+        for (const auto resource : reads)
+        {
+            const auto& access = m_Access[resource];
+            if (access.lastWriter != none)
+            {
+                AddEdge(access.lastWriter, index, *node);
+            }
+        }
+        for (const auto resource : writes)
+        {
+            auto& access = m_Access[resource];
+            access.lastWriter = index;
+            access.readers.clear();
+        }
+        for (const auto resource : reads)
+        {
+            m_Access[resource].readers.push_back(index);
+        }
+        m_Nodes.push_back(std::move(node));
+        return index;
+    }
+
+    //Changes the item count of a system between frames, e.g. when a query matches more chunks
+    void SetItems(std::size_t system, std::size_t items) { m_Nodes[system]->items = items; }
+
+    void Run(WorkStealingPool& pool)
+    {
+        m_Remaining.store(m_Nodes.size(), std::memory_order_relaxed);
+        for (auto& node : m_Nodes)
+        {
+            node->pendingDependencies.store(node->dependencyCount, std::memory_order_relaxed);
+        }
+        for (auto& node : m_Nodes)
+        {
+            if (node->dependencyCount == 0)
+            {
+                Schedule(*node, pool);
+            }
+        }
+        pool.RunUntil([this] { return m_Remaining.load(std::memory_order_acquire) == 0; });
+    }
+
+    //Every system in declaration order on the calling thread, unsplit
+    void RunSerial()
+    {
+        for (auto& node : m_Nodes)
+        {
+            node->work(0, node->items);
+        }
+    }
+
+    [[nodiscard]] std::size_t SystemCount() const { return m_Nodes.size(); }
+    [[nodiscard]] std::size_t EdgeCount() const { return m_EdgeCount; }
+    [[nodiscard]] const std::vector<std::size_t>& Successors(std::size_t system) const
+    {
+        return m_Nodes[system]->successors;
+    }
+    [[nodiscard]] const std::string& Name(std::size_t system) const { return m_Nodes[system]->name; }
+
+private:
+    static constexpr std::size_t none = ~std::size_t{0};
+
+    struct Node
+    {
+        TaskGraph* graph = nullptr;
+        WorkStealingPool* pool = nullptr;
+        std::string name;
+        std::size_t items = 0;
+        std::size_t grain = 1;
+        Work work;
+        std::vector<std::size_t> successors;
+        std::uint32_t dependencyCount = 0;
+        std::atomic<std::uint32_t> pendingDependencies{0};
+        std::atomic<std::size_t> pendingParts{0};
+    };
+
+    struct Access
+    {
+        std::size_t lastWriter = none;
+        std::vector<std::size_t> readers;
+    };
+
+    void AddEdge(std::size_t from, std::size_t to, Node& node)
+    {
+        auto& successors = m_Nodes[from]->successors;
+        if (from == to || std::find(successors.begin(), successors.end(), to) != successors.end())
+        {
+            return;
+        }
+        successors.push_back(to);
+        node.dependencyCount++;
+        m_EdgeCount++;
+    }
+
+    void Schedule(Node& node, WorkStealingPool& pool)
+    {
+        node.pool = &pool;
+        const std::size_t parts = std::max<std::size_t>(1, (node.items + node.grain - 1) / node.grain);
+        node.pendingParts.store(parts, std::memory_order_relaxed);
+        for (std::size_t part = 0; part < parts; part++)
+        {
+            pool.Push({&RunPart, &node, part * node.grain, std::min(node.items, (part + 1) * node.grain)});
+        }
+    }
+
+    static void RunPart(void* context, std::size_t begin, std::size_t end)
+    {
+        auto& node = *static_cast<Node*>(context);
+        if (begin < end)
+        {
+            node.work(begin, end);
+        }
+        if (node.pendingParts.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+        TaskGraph& graph = *node.graph;
+        for (const auto successor : node.successors)
+        {
+            Node& next = *graph.m_Nodes[successor];
+            if (next.pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                graph.Schedule(next, *node.pool);
+            }
+        }
+        graph.m_Remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    std::vector<std::unique_ptr<Node>> m_Nodes;
+    std::unordered_map<std::uint32_t, Access> m_Access;
+    std::size_t m_EdgeCount = 0;
+    std::atomic<std::size_t> m_Remaining{0};
+};
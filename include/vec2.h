@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cmath>
+
+namespace sfge
+{
+struct Vec2f
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    Vec2f(float x, float y)
+        : x(x), y(y)
+    {
+
+    }
+    Vec2f()
+    {
+
+    }
+
+    float GetMagnitude()
+    {
+        return sqrtf(x * x + y * y);
+    }
+
+    Vec2f Normalized()
+    {
+        return (*this) / (*this).GetMagnitude();
+    }
+
+    bool operator==(const Vec2f& rhs) const
+    {
+        return x == rhs.x && y == rhs.y;
+    }
+
+    bool operator!=(const Vec2f& rhs) const
+    {
+        return !(rhs == *this);
+    }
+
+    Vec2f operator+(const Vec2f& rhs) const
+    {
+        return Vec2f(x + rhs.x, y + rhs.y);
+    }
+
+    Vec2f operator-(const Vec2f& rhs) const
+    {
+        return Vec2f(x - rhs.x, y - rhs.y);
+    }
+
+    Vec2f operator*(float rhs) const
+    {
+        return Vec2f(x * rhs, y * rhs);
+    }
+
+    Vec2f operator/(float rhs) const
+    {
+        return (*this) * (1.0f / rhs);
+    }
+
+    Vec2f& operator+=(const Vec2f& rhs)
+    {
+        this->x += rhs.x;
+        this->y += rhs.y;
+        return *this;
+    }
+    Vec2f& operator*=(const float& rhs)
+    {
+        this->x *= rhs;
+        this->y *= rhs;
+        return *this;
+    }
+
+    Vec2f Lerp(const Vec2f& v1, const Vec2f& v2, float t)
+    {
+        return v1 + (v2 - v1) * t;
+    }
+    float Dot(const Vec2f& v1, const Vec2f& v2)
+    {
+        return v1.x * v2.x + v1.y * v2.y;
+    }
+    Vec2f& operator-=(const Vec2f& rhs)
+    {
+        this->x -= rhs.x;
+        this->y -= rhs.y;
+        return *this;
+    }
+};
+}
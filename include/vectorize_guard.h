@@ -0,0 +1,12 @@
+#pragma once
+
+//Brackets a loop that must stay vectorized. The markers end up as comments in the generated
+//assembly (-save-temps) where tools/check_vectorization.py classifies the loop between them.
+//min_isa is one of sse, avx or avx512.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define VECTORIZE_GUARD_BEGIN(name, min_isa) asm volatile("# vectorize_guard begin " name " " min_isa)
+#define VECTORIZE_GUARD_END(name) asm volatile("# vectorize_guard end " name)
+#else
+#define VECTORIZE_GUARD_BEGIN(name, min_isa)
+#define VECTORIZE_GUARD_END(name)
+#endif
@@ -0,0 +1,111 @@
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<std::uint64_t> allocations{0};
+std::atomic<std::uint64_t> frees{0};
+std::atomic<std::uint64_t> bytes{0};
+std::atomic<std::int64_t> liveBytes{0};
+std::atomic<std::int64_t> peakLiveBytes{0};
+
+constexpr std::size_t headerSize = 16;
+
+//Every block carries its size and the malloc pointer just before the returned address:
+//[padding][size][raw pointer][user data aligned to align]
+void* Allocate(std::size_t size, std::size_t align)
+{
+    align = align < headerSize ? headerSize : align;
+    char* raw = static_cast<char*>(std::malloc(size + align + headerSize));
+    if (raw == nullptr)
+    {
+        return nullptr;
+    }
+    const auto address = reinterpret_cast<std::uintptr_t>(raw + headerSize);
+    char* user = reinterpret_cast<char*>((address + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1));
+    reinterpret_cast<std::size_t*>(user)[-2] = size;
+    reinterpret_cast<void**>(user)[-1] = raw;
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::int64_t live = liveBytes.fetch_add(static_cast<std::int64_t>(size), std::memory_order_relaxed) +
+                              static_cast<std::int64_t>(size);
+    std::int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+    return user;
+}
+
+void* AllocateOrAbort(std::size_t size, std::size_t align)
+{
+    void* ptr = Allocate(size, align);
+    if (ptr == nullptr)
+    {
+        std::abort();
+    }
+    return ptr;
+}
+
+void Free(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+    const std::size_t size = reinterpret_cast<std::size_t*>(ptr)[-2];
+    frees.fetch_add(1, std::memory_order_relaxed);
+    liveBytes.fetch_sub(static_cast<std::int64_t>(size), std::memory_order_relaxed);
+    std::free(reinterpret_cast<void**>(ptr)[-1]);
+}
+}
+
+namespace alloc_tracker
+{
+AllocationStats Read()
+{
+    AllocationStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.frees = frees.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    stats.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ResetPeak()
+{
+    peakLiveBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+}
+
+void* operator new(std::size_t size) { return AllocateOrAbort(size, headerSize); }
+void* operator new[](std::size_t size) { return AllocateOrAbort(size, headerSize); }
+void* operator new(std::size_t size, std::align_val_t align) { return AllocateOrAbort(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align) { return AllocateOrAbort(size, static_cast<std::size_t>(align)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, headerSize); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, headerSize); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return Allocate(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return Allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* ptr) noexcept { Free(ptr); }
+void operator delete[](void* ptr) noexcept { Free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { Free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { Free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { Free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { Free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { Free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { Free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { Free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { Free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { Free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { Free(ptr); }
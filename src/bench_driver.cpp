@@ -0,0 +1,26 @@
+#include <benchmark/benchmark.h>
+#include "cache_topology.h"
+#include "harness.h"
+#include "sweep.h"
+
+//Every bench/*.cpp suite compiled with BENCH_DRIVER into one binary, sizes and thread counts come
+//from the config file instead of a rebuild:
+//  bench_driver --bench_config=config/sweeps.example.ini --benchmark_filter=BM_Stream
+//  bench_driver --bench_list_sweeps
+int main(int argc, char** argv)
+{
+    AddCacheTopologyContext();
+    const HarnessOptions harnessOptions = ParseHarnessFlags(argc, argv);
+    if (!ConfigureSweeps(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    RunHarnessedBenchmarks(harnessOptions);
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,468 @@
+#!/usr/bin/env python3
+"""Stores benchmark results and compares two runs for statistically significant changes.
+
+A run is a directory of the store holding the JSON output of every bench target plus
+meta.json (git revision, host, CPU and cache topology as reported by the targets).
+
+    bench_results.py record <build dir> [--repetitions 10] [--filter regex] [--label text]
+    bench_results.py ingest <file.json>... [--label text]
+    bench_results.py list
+    bench_results.py compare <baseline> <candidate> [--metric real_time] [--alpha 0.05]
+                             [--threshold 0.02] [--markdown report.md] [--fail-on-regression]
+
+Runs are named by id, unique id prefix, label, "latest" or "latest~N". Each benchmark is
+compared on its repetitions with a two-sided Mann-Whitney U test (exact for small samples
+without ties) and a bootstrap confidence interval of the ratio of medians. A change is
+significant when p < alpha, the interval excludes 1 and the median moved by more than the
+threshold. Only the standard library is used.
+"""
+import argparse
+import datetime
+import json
+import math
+import os
+import pathlib
+import platform
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+
+DEFAULT_STORE = "bench_results"
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+CONTEXT_KEYS = ("host_name", "num_cpus", "mhz_per_cpu", "cpu_scaling_enabled", "caches", "library_build_type")
+BOOTSTRAP_SAMPLES = 2000
+
+
+# ---------------------------------------------------------------------------------------------
+# Store
+
+def git_revision(directory):
+    def git(*arguments):
+        try:
+            result = subprocess.run(["git", "-C", str(directory), *arguments], capture_output=True, text=True)
+        except OSError:
+            return None
+        return result.stdout.strip() if result.returncode == 0 else None
+
+    revision = git("rev-parse", "HEAD")
+    status = git("status", "--porcelain", "--untracked-files=no")
+    return {"revision": revision, "dirty": bool(status), "subject": git("log", "-1", "--format=%s")}
+
+
+def cpu_model():
+    try:
+        for line in pathlib.Path("/proc/cpuinfo").read_text().splitlines():
+            if line.startswith("model name"):
+                return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor() or platform.machine()
+
+
+def host_info():
+    uname = platform.uname()
+    return {"node": uname.node, "system": uname.system, "release": uname.release, "machine": uname.machine,
+            "cpu_model": cpu_model(), "cpu_count": os.cpu_count()}
+
+
+def new_run(store, label, source_dir):
+    revision = git_revision(source_dir)
+    stamp = datetime.datetime.now().strftime("%Y%m%d-%H%M%S")
+    base_id = f"{stamp}-{(revision['revision'] or 'norev')[:7]}"
+    store.mkdir(parents=True, exist_ok=True)
+    #Ids have a one second resolution, later runs of the same second get a suffix
+    for attempt in range(1000):
+        run_id = base_id if attempt == 0 else f"{base_id}-{attempt}"
+        directory = store / run_id
+        try:
+            directory.mkdir()
+            break
+        except FileExistsError:
+            continue
+    else:
+        raise RuntimeError(f"no free run id for {base_id} in {store}")
+    meta = {"id": run_id, "label": label, "created": datetime.datetime.now().isoformat(timespec="seconds"),
+            "git": revision, "host": host_info(), "context": {}, "targets": []}
+    return directory, meta
+
+
+def add_target(directory, meta, target, result_path):
+    """Records the target and keeps the topology context reported by its JSON output."""
+    try:
+        data = json.loads(result_path.read_text())
+    except (OSError, ValueError) as error:
+        print(f"warning: {result_path}: {error}", file=sys.stderr)
+        return
+    if result_path.parent != directory:
+        shutil.copyfile(result_path, directory / f"{target}.json")
+    context = data.get("context", {})
+    for key, value in context.items():
+        if key in CONTEXT_KEYS or key.startswith("cache_L"):
+            meta["context"].setdefault(key, value)
+    meta["targets"].append(target)
+
+
+def write_meta(directory, meta):
+    (directory / "meta.json").write_text(json.dumps(meta, indent=2) + "\n")
+
+
+def bench_executables(build_dir):
+    #bench_driver links every suite, running it too would record each benchmark twice
+    return sorted(path for path in pathlib.Path(build_dir).iterdir()
+                  if path.name.startswith("bench_") and path.name != "bench_driver" and path.is_file()
+                  and os.access(path, os.X_OK))
+
+
+def record(arguments):
+    store = pathlib.Path(arguments.store)
+    executables = bench_executables(arguments.build_dir)
+    if arguments.targets:
+        executables = [path for path in executables if path.name in arguments.targets]
+    if not executables:
+        print(f"no bench_* executables in {arguments.build_dir}", file=sys.stderr)
+        return 1
+    directory, meta = new_run(store, arguments.label, arguments.source_dir)
+    meta["repetitions"] = arguments.repetitions
+    failures = 0
+    for executable in executables:
+        output = directory / f"{executable.name}.json"
+        command = [str(executable), f"--benchmark_repetitions={arguments.repetitions}",
+                   "--benchmark_display_aggregates_only=true",
+                   f"--benchmark_out={output}", "--benchmark_out_format=json"]
+        if arguments.filter:
+            command.append(f"--benchmark_filter={arguments.filter}")
+        print(f"== {executable.name}", flush=True)
+        if subprocess.run(command).returncode != 0:
+            print(f"warning: {executable.name} exited with an error", file=sys.stderr)
+            failures += 1
+        if output.exists():
+            add_target(directory, meta, executable.name, output)
+    write_meta(directory, meta)
+    print(f"recorded run {meta['id']} ({len(meta['targets'])} targets) in {directory}")
+    return 1 if failures else 0
+
+
+def ingest(arguments):
+    store = pathlib.Path(arguments.store)
+    directory, meta = new_run(store, arguments.label, arguments.source_dir)
+    for name in arguments.files:
+        path = pathlib.Path(name)
+        add_target(directory, meta, path.stem, path)
+    write_meta(directory, meta)
+    print(f"ingested run {meta['id']} ({len(meta['targets'])} targets) in {directory}")
+    return 0
+
+
+def load_runs(store):
+    runs = []
+    if not store.is_dir():
+        return runs
+    for meta_path in sorted(store.glob("*/meta.json")):
+        try:
+            runs.append(json.loads(meta_path.read_text()))
+        except (OSError, ValueError):
+            continue
+    return sorted(runs, key=lambda meta: meta["id"])
+
+
+def resolve_run(store, name):
+    runs = load_runs(store)
+    if name.startswith("latest"):
+        back = int(name[7:]) if name.startswith("latest~") else 0
+        return runs[-1 - back]["id"] if back < len(runs) else None
+    matches = [meta["id"] for meta in runs if meta["id"] == name or meta.get("label") == name]
+    if not matches:
+        matches = [meta["id"] for meta in runs if meta["id"].startswith(name)]
+    if len(matches) > 1:
+        print(f"'{name}' is ambiguous: {', '.join(matches)}", file=sys.stderr)
+        return None
+    return matches[0] if matches else None
+
+
+def list_runs(arguments):
+    for meta in load_runs(pathlib.Path(arguments.store)):
+        git = meta.get("git", {})
+        revision = (git.get("revision") or "?")[:10] + ("+" if git.get("dirty") else "")
+        print(f"{meta['id']:28} {revision:12} {meta['host'].get('node', '?'):16} "
+              f"{len(meta['targets']):3} targets  {meta.get('label') or ''}")
+    return 0
+
+
+# ---------------------------------------------------------------------------------------------
+# Statistics
+
+def ranks(values):
+    """Average ranks (1-based) and the tie correction term sum(t^3 - t)."""
+    order = sorted(range(len(values)), key=lambda index: values[index])
+    result = [0.0] * len(values)
+    ties = 0.0
+    start = 0
+    while start < len(order):
+        end = start
+        while end + 1 < len(order) and values[order[end + 1]] == values[order[start]]:
+            end += 1
+        for position in range(start, end + 1):
+            result[order[position]] = (start + end) / 2.0 + 1.0
+        count = end - start + 1
+        ties += count ** 3 - count
+        start = end + 1
+    return result, ties
+
+
+def exact_u_cdf(n1, n2):
+    """Cumulative distribution of U for samples of n1 and n2 without ties."""
+    #counts[n][m][u]: arrangements of n and m values whose U statistic is u
+    counts = {(0, m): [1] for m in range(n2 + 1)}
+    for n in range(1, n1 + 1):
+        counts[(n, 0)] = [1]
+        for m in range(1, n2 + 1):
+            size = n * m + 1
+            row = [0] * size
+            for u, count in enumerate(counts[(n - 1, m)]):
+                row[u + m] += count
+            for u, count in enumerate(counts[(n, m - 1)]):
+                row[u] += count
+            counts[(n, m)] = row
+    total = math.comb(n1 + n2, n1)
+    cumulative = []
+    running = 0
+    for count in counts[(n1, n2)]:
+        running += count
+        cumulative.append(running / total)
+    return cumulative
+
+
+def mann_whitney(a, b):
+    """Two-sided Mann-Whitney U test, returns (U of a, p-value)."""
+    n1, n2 = len(a), len(b)
+    rank, ties = ranks(list(a) + list(b))
+    u1 = sum(rank[:n1]) - n1 * (n1 + 1) / 2.0
+    u_min = min(u1, n1 * n2 - u1)
+    if ties == 0 and n1 <= 20 and n2 <= 20:
+        cdf = exact_u_cdf(n1, n2)
+        return u1, min(1.0, 2.0 * cdf[int(u_min)])
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)))
+    if variance <= 0:
+        return u1, 1.0
+    z = (abs(u1 - n1 * n2 / 2.0) - 0.5) / math.sqrt(variance)
+    return u1, min(1.0, math.erfc(max(z, 0.0) / math.sqrt(2.0)))
+
+
+def bootstrap_ratio_ci(baseline, candidate, confidence, rng):
+    """Percentile bootstrap interval of median(candidate) / median(baseline)."""
+    ratios = []
+    for _ in range(BOOTSTRAP_SAMPLES):
+        base = statistics.median(rng.choices(baseline, k=len(baseline)))
+        cand = statistics.median(rng.choices(candidate, k=len(candidate)))
+        if base > 0:
+            ratios.append(cand / base)
+    if not ratios:
+        return math.nan, math.nan
+    ratios.sort()
+    tail = (1.0 - confidence) / 2.0
+    low = ratios[int(tail * (len(ratios) - 1))]
+    high = ratios[int(math.ceil((1.0 - tail) * (len(ratios) - 1)))]
+    return low, high
+
+
+# ---------------------------------------------------------------------------------------------
+# Comparison
+
+def samples(store, run_id, metric):
+    """Per-repetition values of every benchmark of a run, keyed by target and run name.
+
+    Benchmarks whose output only holds aggregates (ReportAggregatesOnly) fall back to their
+    median aggregate, a single sample that compare reports as "few samples"."""
+    result = {}
+    for path in sorted((store / run_id).glob("*.json")):
+        if path.name == "meta.json":
+            continue
+        try:
+            data = json.loads(path.read_text())
+        except (OSError, ValueError):
+            continue
+        medians = {}
+        for entry in data.get("benchmarks", []):
+            if entry.get("error_occurred"):
+                continue
+            run_type = entry.get("run_type", "iteration")
+            if run_type != "iteration" and entry.get("aggregate_name") != "median":
+                continue
+            value = entry.get(metric)
+            if value is None:
+                continue
+            if metric in ("real_time", "cpu_time"):
+                value *= TIME_UNITS.get(entry.get("time_unit", "ns"), 1.0)
+            key = (path.stem, entry.get("run_name", entry["name"]))
+            if run_type == "iteration":
+                result.setdefault(key, []).append(float(value))
+            else:
+                medians[key] = float(value)
+        fallback = [key for key in medians if key not in result]
+        if fallback:
+            print(f"warning: {run_id}/{path.name}: {len(fallback)} benchmarks only have aggregates, "
+                  f"using their median (e.g. {fallback[0][1]})", file=sys.stderr)
+            for key in fallback:
+                result[key] = [medians[key]]
+    return result
+
+
+def host_differences(base, cand):
+    notes = []
+    for section, keys in (("host", ("cpu_model", "cpu_count", "machine")),
+                          ("context", ("num_cpus", "mhz_per_cpu", "cpu_scaling_enabled", "library_build_type"))):
+        for key in keys:
+            before, after = base.get(section, {}).get(key), cand.get(section, {}).get(key)
+            if before != after:
+                notes.append(f"{key}: {before} -> {after}")
+    if base.get("context", {}).get("caches") != cand.get("context", {}).get("caches"):
+        notes.append("cache topology differs")
+    return notes
+
+
+def compare_benchmark(baseline, candidate, arguments, rng):
+    base_median = statistics.median(baseline)
+    cand_median = statistics.median(candidate)
+    ratio = cand_median / base_median if base_median > 0 else math.nan
+    row = {"baseline": base_median, "candidate": cand_median, "ratio": ratio,
+           "p": math.nan, "low": math.nan, "high": math.nan, "verdict": "same"}
+    if len(baseline) < 3 or len(candidate) < 3:
+        row["verdict"] = "few samples"
+        return row
+    _, row["p"] = mann_whitney(baseline, candidate)
+    row["low"], row["high"] = bootstrap_ratio_ci(baseline, candidate, arguments.confidence, rng)
+    slower = ratio > 1.0 + arguments.threshold and row["low"] > 1.0
+    faster = ratio < 1.0 - arguments.threshold and row["high"] < 1.0
+    if arguments.higher_is_better:
+        slower, faster = faster, slower
+    if row["p"] < arguments.alpha and slower:
+        row["verdict"] = "REGRESSION"
+    elif row["p"] < arguments.alpha and faster:
+        row["verdict"] = "improvement"
+    return row
+
+
+def format_value(value, metric):
+    if metric not in ("real_time", "cpu_time"):
+        return f"{value:.4g}"
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if value >= scale:
+            return f"{value / scale:.3f} {unit}"
+    return f"{value:.1f} ns"
+
+
+def print_report(rows, metric, color):
+    red, green, reset = ("\033[1;31m", "\033[32m", "\033[0m") if color else ("", "", "")
+    width = max([len(f"{target}/{name}") for (target, name) in rows] + [9])
+    print(f"{'benchmark':{width}} {'baseline':>12} {'candidate':>12} {'change':>8} {'95% CI':>17} {'p':>7}  verdict")
+    for (target, name), row in rows.items():
+        change = (row["ratio"] - 1.0) * 100.0
+        interval = "" if math.isnan(row["low"]) else \
+            f"[{(row['low'] - 1) * 100:+.1f},{(row['high'] - 1) * 100:+.1f}]%"
+        p = "" if math.isnan(row["p"]) else f"{row['p']:.3f}"
+        shade = red if row["verdict"] == "REGRESSION" else green if row["verdict"] == "improvement" else ""
+        print(f"{shade}{target + '/' + name:{width}} {format_value(row['baseline'], metric):>12} "
+              f"{format_value(row['candidate'], metric):>12} {change:+7.1f}% {interval:>17} {p:>7}  "
+              f"{row['verdict']}{reset if shade else ''}")
+
+
+def write_markdown(path, rows, metric, base_meta, cand_meta, notes):
+    lines = [f"# Benchmark comparison ({metric})", "",
+             f"- baseline: `{base_meta['id']}` {base_meta['git'].get('subject') or ''}",
+             f"- candidate: `{cand_meta['id']}` {cand_meta['git'].get('subject') or ''}"]
+    lines += [f"- host change: {note}" for note in notes]
+    lines += ["", "| benchmark | baseline | candidate | change | CI | p | verdict |",
+              "|---|---:|---:|---:|---:|---:|---|"]
+    for (target, name), row in rows.items():
+        interval = "" if math.isnan(row["low"]) else \
+            f"{(row['low'] - 1) * 100:+.1f}% .. {(row['high'] - 1) * 100:+.1f}%"
+        p = "" if math.isnan(row["p"]) else f"{row['p']:.3f}"
+        verdict = f"**{row['verdict']}**" if row["verdict"] == "REGRESSION" else row["verdict"]
+        lines.append(f"| `{target}/{name}` | {format_value(row['baseline'], metric)} | "
+                     f"{format_value(row['candidate'], metric)} | {(row['ratio'] - 1) * 100:+.1f}% | "
+                     f"{interval} | {p} | {verdict} |")
+    pathlib.Path(path).write_text("\n".join(lines) + "\n")
+
+
+def compare(arguments):
+    store = pathlib.Path(arguments.store)
+    ids = [resolve_run(store, name) for name in (arguments.baseline, arguments.candidate)]
+    if None in ids:
+        print("unknown run, see 'bench_results.py list'", file=sys.stderr)
+        return 2
+    metas = [json.loads((store / run_id / "meta.json").read_text()) for run_id in ids]
+    base_samples, cand_samples = (samples(store, run_id, arguments.metric) for run_id in ids)
+
+    notes = host_differences(*metas)
+    print(f"baseline  {ids[0]}\ncandidate {ids[1]}")
+    for note in notes:
+        print(f"warning: host differs, {note}")
+
+    rng = random.Random(1)
+    rows = {key: compare_benchmark(base_samples[key], cand_samples[key], arguments, rng)
+            for key in sorted(base_samples) if key in cand_samples}
+    if not rows:
+        print(f"no benchmark with a '{arguments.metric}' value in both runs")
+        return 1
+    color = sys.stdout.isatty() and not arguments.no_color
+    print_report(rows, arguments.metric, color)
+    for key in sorted(set(base_samples) ^ set(cand_samples)):
+        print(f"only in {'baseline' if key in base_samples else 'candidate'}: {key[0]}/{key[1]}")
+
+    regressions = sum(row["verdict"] == "REGRESSION" for row in rows.values())
+    improvements = sum(row["verdict"] == "improvement" for row in rows.values())
+    print(f"{len(rows)} compared, {regressions} significant regressions, {improvements} significant improvements")
+    if arguments.markdown:
+        write_markdown(arguments.markdown, rows, arguments.metric, metas[0], metas[1], notes)
+    return 1 if regressions and arguments.fail_on_regression else 0
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--store", default=os.environ.get("BENCH_RESULTS_STORE", DEFAULT_STORE),
+                        help="result store directory (default $BENCH_RESULTS_STORE or ./bench_results)")
+    parser.add_argument("--source-dir", default=pathlib.Path(__file__).resolve().parent.parent,
+                        help="git checkout the revision is read from")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record_parser = commands.add_parser("record", help="run every bench_* target of a build dir and store it")
+    record_parser.add_argument("build_dir")
+    record_parser.add_argument("--repetitions", type=int, default=10)
+    record_parser.add_argument("--filter", help="forwarded as --benchmark_filter")
+    record_parser.add_argument("--targets", nargs="*", help="only these executables")
+    record_parser.add_argument("--label")
+    record_parser.set_defaults(handler=record)
+
+    ingest_parser = commands.add_parser("ingest", help="store existing --benchmark_out JSON files as a run")
+    ingest_parser.add_argument("files", nargs="+")
+    ingest_parser.add_argument("--label")
+    ingest_parser.set_defaults(handler=ingest)
+
+    list_parser = commands.add_parser("list", help="list stored runs")
+    list_parser.set_defaults(handler=list_runs)
+
+    compare_parser = commands.add_parser("compare", help="compare two stored runs")
+    compare_parser.add_argument("baseline")
+    compare_parser.add_argument("candidate")
+    compare_parser.add_argument("--metric", default="real_time",
+                                help="real_time, cpu_time or any counter of the JSON output")
+    compare_parser.add_argument("--higher-is-better", action="store_true",
+                                help="for throughput counters such as items_per_second")
+    compare_parser.add_argument("--alpha", type=float, default=0.05)
+    compare_parser.add_argument("--confidence", type=float, default=0.95)
+    compare_parser.add_argument("--threshold", type=float, default=0.02,
+                                help="minimum relative change of the median to report")
+    compare_parser.add_argument("--markdown", help="also write the report as markdown")
+    compare_parser.add_argument("--fail-on-regression", action="store_true", help="exit with 1 on regressions")
+    compare_parser.add_argument("--no-color", action="store_true")
+    compare_parser.set_defaults(handler=compare)
+
+    arguments = parser.parse_args(argv)
+    return arguments.handler(arguments)
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
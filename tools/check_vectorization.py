@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Checks that loops bracketed with VECTORIZE_GUARD_BEGIN/END stayed vectorized.
+
+Reads the Intel-syntax assembly produced by -save-temps (-masm=intel -ffat-lto-objects),
+finds every guarded region, extracts its loops (backward branches to a local label) and
+classifies the hot loop, the widest one, as scalar, SSE, AVX or AVX-512.
+
+Usage: check_vectorization.py <build dir or .s files>...
+Exits with 1 when a guarded loop is narrower than the ISA requested in its marker.
+"""
+import pathlib
+import re
+import sys
+
+CLASSES = ["scalar", "sse", "avx", "avx512"]
+
+MARKER = re.compile(r"#\s*vectorize_guard (begin|end) (\S+)(?: (\S+))?")
+LOCAL_LABEL = re.compile(r"^(\.L\w+):")
+FUNCTION_LABEL = re.compile(r"^([A-Za-z_][\w.$]*):")
+JUMP = re.compile(r"^\s+(j\w+)\s+(\.L\w+)\s*$")
+SCALAR_SUFFIX = re.compile(r"(ss|sd|sh)$")
+SCALAR_MOVES = {"movd", "vmovd", "movq", "vmovq", "vpextrd", "pextrd", "vpinsrd", "pinsrd"}
+
+
+def classify_instruction(line):
+    parts = line.split(None, 1)
+    if not parts or parts[0].startswith((".", "#")):
+        return 0
+    mnemonic = parts[0]
+    operands = parts[1] if len(parts) > 1 else ""
+    if "zmm" in operands:
+        return 3
+    if "ymm" in operands:
+        return 2
+    if "xmm" in operands:
+        if SCALAR_SUFFIX.search(mnemonic) or mnemonic in SCALAR_MOVES or "cvtsi2" in mnemonic:
+            return 0
+        return 1
+    return 0
+
+
+def find_loops(lines):
+    """Returns (start, end) line ranges of the loops in a region."""
+    labels = {}
+    loops = []
+    for index, line in enumerate(lines):
+        label = LOCAL_LABEL.match(line)
+        if label:
+            labels[label.group(1)] = index
+            continue
+        jump = JUMP.match(line)
+        if jump and jump.group(2) in labels:
+            loops.append((labels[jump.group(2)], index))
+    return loops
+
+
+def classify_region(lines):
+    loops = find_loops(lines)
+    if not loops:
+        width = max((classify_instruction(line) for line in lines), default=0)
+        return width, 0
+    width = 0
+    for start, end in loops:
+        width = max(width, max((classify_instruction(line) for line in lines[start:end + 1]), default=0))
+    return width, len(loops)
+
+
+def guarded_regions(path):
+    function = "?"
+    open_regions = {}
+    for line in path.read_text(errors="replace").splitlines():
+        label = FUNCTION_LABEL.match(line)
+        if label:
+            function = label.group(1)
+        marker = MARKER.search(line)
+        if marker:
+            kind, name, isa = marker.groups()
+            if kind == "begin":
+                open_regions[name] = (isa or "sse", function, [])
+            elif name in open_regions:
+                isa, owner, body = open_regions.pop(name)
+                yield name, isa, owner, body
+            continue
+        for _, _, body in open_regions.values():
+            body.append(line)
+
+
+def collect_files(arguments):
+    files = []
+    for argument in arguments:
+        path = pathlib.Path(argument)
+        if path.is_dir():
+            files.extend(sorted(path.rglob("*.s")))
+        else:
+            files.append(path)
+    return files
+
+
+def main(arguments):
+    if not arguments:
+        print(__doc__)
+        return 2
+    failures = 0
+    regions = 0
+    for path in collect_files(arguments):
+        for name, isa, function, body in guarded_regions(path):
+            regions += 1
+            width, loop_count = classify_region(body)
+            expected = CLASSES.index(isa) if isa in CLASSES else 1
+            status = "ok" if width >= expected else "FAIL"
+            failures += status == "FAIL"
+            print(f"{status:4} {name:40} {CLASSES[width]:7} (min {isa}, {loop_count} loops) "
+                  f"in {function} [{path.name}]")
+    if regions == 0:
+        print("no guarded loops found, is the build optimized with -save-temps -ffat-lto-objects?")
+        return 1
+    print(f"{regions} guarded regions, {failures} fell back below their required ISA")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))